@@ -0,0 +1,78 @@
+#include "Arena.h"
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+Arena::Arena() : cursor(nullptr), limit(nullptr) { }
+
+Arena::Arena(Arena&& other) noexcept : blocks(std::move(other.blocks)), cursor(other.cursor), limit(other.limit)
+{
+	other.blocks.clear();
+	other.cursor = nullptr;
+	other.limit = nullptr;
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept
+{
+	if (this != &other) {
+		blocks = std::move(other.blocks);
+		cursor = other.cursor;
+		limit = other.limit;
+		other.blocks.clear();
+		other.cursor = nullptr;
+		other.limit = nullptr;
+	}
+	return *this;
+}
+
+void Arena::grow(size_t bytes)
+{
+	size_t size = bytes > BLOCK_SIZE ? bytes : BLOCK_SIZE;
+	blocks.push_back({ std::unique_ptr<char[]>(new char[size]), size });
+	cursor = blocks.back().memory.get();
+	limit = cursor + size;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t address = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (cursor == nullptr || address + bytes > reinterpret_cast<uintptr_t>(limit)) {
+		grow(bytes + alignment);
+		address = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+	cursor = reinterpret_cast<char*>(address + bytes);
+	return reinterpret_cast<void*>(address);
+}
+
+std::string_view Arena::copyString(std::string_view str)
+{
+	if (str.empty())
+		return std::string_view();
+	char* copy = static_cast<char*>(allocate(str.size(), 1));
+	memcpy(copy, str.data(), str.size());
+	return std::string_view(copy, str.size());
+}
+
+void Arena::adopt(Arena&& other)
+{
+	if (this == &other)
+		return;
+	// The current block stays last so that allocation keeps bumping into it.
+	blocks.insert(blocks.begin(), std::make_move_iterator(other.blocks.begin()), std::make_move_iterator(other.blocks.end()));
+	other.clear();
+}
+
+void Arena::clear()
+{
+	blocks.clear();
+	cursor = nullptr;
+	limit = nullptr;
+}
+
+size_t Arena::capacity() const
+{
+	size_t total = 0;
+	for (const Block& block : blocks)
+		total += block.size;
+	return total;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Monotonic bump allocator. Memory handed out stays valid until the arena is destroyed or cleared;
+// there is no per-allocation free.
+class Arena {
+private:
+	struct Block {
+		std::unique_ptr<char[]> memory;
+		size_t size;
+	};
+
+	// Size of a regular block. Larger requests get a block of their own.
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	std::vector<Block> blocks;
+	char* cursor;
+	char* limit;
+
+	// Adds a new block that can fit at least the requested amount of bytes.
+	void grow(size_t bytes);
+public:
+	Arena();
+	Arena(Arena&& other) noexcept;
+	Arena& operator=(Arena&& other) noexcept;
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Returns uninitialized memory aligned to alignment (which must be a power of two).
+	void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+	// Constructs a T in arena memory. Its destructor is never run, so T should be trivially destructible.
+	template <class T, class... Args>
+	T* create(Args&&... args)
+	{
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// Copies str into the arena and returns a view of the copy.
+	std::string_view copyString(std::string_view str);
+
+	// Takes ownership of every block in other, leaving it empty.
+	// Memory handed out by other stays valid.
+	void adopt(Arena&& other);
+
+	// Releases every block at once.
+	void clear();
+
+	// Total bytes reserved from the system.
+	size_t capacity() const;
+};
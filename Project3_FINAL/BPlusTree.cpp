@@ -0,0 +1,283 @@
+#include "BPlusTree.h"
+#include <algorithm>
+
+BPlusTree::BPlusTree(Wine::Properties _searchBy) : root(nullptr), numKeys(0), height(0)
+{
+	switch (_searchBy) {
+	case Wine::Properties::VARIETY:
+		getKey = &Wine::getVarietyView;
+		break;
+	case Wine::Properties::PROVINCE:
+		getKey = &Wine::getProvinceView;
+		break;
+	case Wine::Properties::COUNTRY:
+		getKey = &Wine::getCountryView;
+		break;
+	default:
+		getKey = &Wine::getTitleView;
+	}
+}
+
+BPlusTree::~BPlusTree() { }
+
+uint64_t BPlusTree::keyPrefix(std::string_view key)
+{
+	uint64_t prefix = 0;
+	size_t length = std::min<size_t>(key.size(), 8);
+	for (size_t i = 0; i < length; i++)
+		prefix |= (uint64_t)(unsigned char)key[i] << (56 - 8 * i);
+	return prefix;
+}
+
+int BPlusTree::compareAt(const Node* node, int index, uint64_t prefix, std::string_view key)
+{
+	if (node->prefixes[index] != prefix)
+		return node->prefixes[index] < prefix ? -1 : 1;
+	return node->keys[index].compare(key);
+}
+
+int BPlusTree::lowerIndex(const Node* node, uint64_t prefix, std::string_view key)
+{
+	int low = 0, high = node->count;
+	while (low < high) {
+		int middle = (low + high) / 2;
+		if (compareAt(node, middle, prefix, key) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+void BPlusTree::insert(Wine* w)
+{
+	std::string_view key = (w->*getKey)();
+	uint64_t prefix = keyPrefix(key);
+	if (root == nullptr) {
+		root = nodeArena.create<LeafNode>();
+		height = 1;
+	}
+
+	Split split;
+	if (insertInto(root, w, prefix, key, split)) {
+		// The root split, so the tree grows one level at the top.
+		InnerNode* newRoot = nodeArena.create<InnerNode>();
+		newRoot->count = 1;
+		newRoot->prefixes[0] = split.prefix;
+		newRoot->keys[0] = split.separator;
+		newRoot->children[0] = root;
+		newRoot->children[1] = split.right;
+		root = newRoot;
+		height++;
+	}
+}
+
+bool BPlusTree::insertInto(Node* node, Wine* w, uint64_t prefix, std::string_view key, Split& split)
+{
+	int index = lowerIndex(node, prefix, key);
+
+	if (node->isLeaf) {
+		LeafNode* leaf = static_cast<LeafNode*>(node);
+		if (index < leaf->count && compareAt(leaf, index, prefix, key) == 0) {
+			leaf->duplicates[index] = nodeArena.create<duplicateNode>(w, leaf->duplicates[index]);
+			return false;
+		}
+		numKeys++;
+
+		bool didSplit = false;
+		if (leaf->count == MAX_KEYS) {
+			// Moves the upper half into a new leaf, linked in after this one.
+			LeafNode* right = nodeArena.create<LeafNode>();
+			int keep = (MAX_KEYS + 1) / 2;
+			right->count = MAX_KEYS - keep;
+			std::copy(leaf->prefixes + keep, leaf->prefixes + MAX_KEYS, right->prefixes);
+			std::copy(leaf->keys + keep, leaf->keys + MAX_KEYS, right->keys);
+			std::copy(leaf->rows + keep, leaf->rows + MAX_KEYS, right->rows);
+			std::copy(leaf->duplicates + keep, leaf->duplicates + MAX_KEYS, right->duplicates);
+			leaf->count = keep;
+			right->next = leaf->next;
+			leaf->next = right;
+
+			split.right = right;
+			split.prefix = right->prefixes[0];
+			split.separator = right->keys[0];
+			didSplit = true;
+			// A key that lands exactly at keep still sorts before the separator, so it stays on the left.
+			if (index > keep) {
+				leaf = right;
+				index -= keep;
+			}
+		}
+
+		std::copy_backward(leaf->prefixes + index, leaf->prefixes + leaf->count, leaf->prefixes + leaf->count + 1);
+		std::copy_backward(leaf->keys + index, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+		std::copy_backward(leaf->rows + index, leaf->rows + leaf->count, leaf->rows + leaf->count + 1);
+		std::copy_backward(leaf->duplicates + index, leaf->duplicates + leaf->count, leaf->duplicates + leaf->count + 1);
+		leaf->prefixes[index] = prefix;
+		leaf->keys[index] = key;
+		leaf->rows[index] = w;
+		leaf->duplicates[index] = nullptr;
+		leaf->count++;
+		return didSplit;
+	}
+
+	// Keys equal to a separator live in the subtree to its right.
+	InnerNode* inner = static_cast<InnerNode*>(node);
+	int child = index < inner->count && compareAt(inner, index, prefix, key) == 0 ? index + 1 : index;
+	Split childSplit;
+	if (!insertInto(inner->children[child], w, prefix, key, childSplit))
+		return false;
+
+	bool didSplit = false;
+	if (inner->count == MAX_KEYS) {
+		// keys[middle] moves up; the keys and children after it move into a new node.
+		InnerNode* right = nodeArena.create<InnerNode>();
+		int middle = MAX_KEYS / 2;
+		right->count = MAX_KEYS - middle - 1;
+		std::copy(inner->prefixes + middle + 1, inner->prefixes + MAX_KEYS, right->prefixes);
+		std::copy(inner->keys + middle + 1, inner->keys + MAX_KEYS, right->keys);
+		std::copy(inner->children + middle + 1, inner->children + MAX_KEYS + 1, right->children);
+		inner->count = middle;
+
+		split.right = right;
+		split.prefix = inner->prefixes[middle];
+		split.separator = inner->keys[middle];
+		didSplit = true;
+		if (child > middle) {
+			inner = right;
+			child -= middle + 1;
+		}
+	}
+
+	std::copy_backward(inner->prefixes + child, inner->prefixes + inner->count, inner->prefixes + inner->count + 1);
+	std::copy_backward(inner->keys + child, inner->keys + inner->count, inner->keys + inner->count + 1);
+	std::copy_backward(inner->children + child + 1, inner->children + inner->count + 1, inner->children + inner->count + 2);
+	inner->prefixes[child] = childSplit.prefix;
+	inner->keys[child] = childSplit.separator;
+	inner->children[child + 1] = childSplit.right;
+	inner->count++;
+	return didSplit;
+}
+
+const BPlusTree::LeafNode* BPlusTree::findLeaf(uint64_t prefix, std::string_view key, int& index) const
+{
+	const Node* node = root;
+	if (node == nullptr)
+		return nullptr;
+	while (!node->isLeaf) {
+		const InnerNode* inner = static_cast<const InnerNode*>(node);
+		int child = lowerIndex(inner, prefix, key);
+		if (child < inner->count && compareAt(inner, child, prefix, key) == 0)
+			child++;
+		node = inner->children[child];
+	}
+	index = lowerIndex(node, prefix, key);
+	return static_cast<const LeafNode*>(node);
+}
+
+void BPlusTree::search(Wine* searchKey, std::vector<Wine*>& results)
+{
+	search((searchKey->*getKey)(), results);
+}
+
+void BPlusTree::search(std::string_view searchKey, std::vector<Wine*>& results) const
+{
+	uint64_t prefix = keyPrefix(searchKey);
+	int index;
+	const LeafNode* leaf = findLeaf(prefix, searchKey, index);
+	if (leaf == nullptr || index >= leaf->count || compareAt(leaf, index, prefix, searchKey) != 0)
+		return;
+	results.push_back(leaf->rows[index]);
+	for (duplicateNode* duplicate = leaf->duplicates[index]; duplicate != nullptr; duplicate = duplicate->next)
+		results.push_back(duplicate->data);
+}
+
+BPlusTree::Iterator::Iterator(const LeafNode* _leaf, int _index) : leaf(_leaf), index(_index)
+{
+	// Normalizes a position past a leaf's last key to the start of the next leaf.
+	while (leaf != nullptr && index >= leaf->count) {
+		leaf = leaf->next;
+		index = 0;
+	}
+}
+
+std::string_view BPlusTree::Iterator::key() const
+{
+	return leaf->keys[index];
+}
+
+void BPlusTree::Iterator::rows(std::vector<Wine*>& results) const
+{
+	results.push_back(leaf->rows[index]);
+	for (duplicateNode* duplicate = leaf->duplicates[index]; duplicate != nullptr; duplicate = duplicate->next)
+		results.push_back(duplicate->data);
+}
+
+BPlusTree::Iterator& BPlusTree::Iterator::operator++()
+{
+	*this = Iterator(leaf, index + 1);
+	return *this;
+}
+
+bool BPlusTree::Iterator::operator==(const Iterator& other) const
+{
+	return leaf == other.leaf && index == other.index;
+}
+
+bool BPlusTree::Iterator::operator!=(const Iterator& other) const
+{
+	return !(*this == other);
+}
+
+BPlusTree::Iterator BPlusTree::begin() const
+{
+	const Node* node = root;
+	if (node == nullptr)
+		return end();
+	while (!node->isLeaf)
+		node = static_cast<const InnerNode*>(node)->children[0];
+	return Iterator(static_cast<const LeafNode*>(node), 0);
+}
+
+BPlusTree::Iterator BPlusTree::end() const
+{
+	return Iterator();
+}
+
+BPlusTree::Iterator BPlusTree::lowerBound(std::string_view key) const
+{
+	int index;
+	const LeafNode* leaf = findLeaf(keyPrefix(key), key, index);
+	return leaf == nullptr ? end() : Iterator(leaf, index);
+}
+
+BPlusTree::Iterator BPlusTree::upperBound(std::string_view key) const
+{
+	Iterator bound = lowerBound(key);
+	if (bound != end() && bound.key() == key)
+		++bound;
+	return bound;
+}
+
+void BPlusTree::searchRange(std::string_view low, std::string_view high, std::vector<Wine*>& results) const
+{
+	for (Iterator current = lowerBound(low); current != end() && current.key() <= high; ++current)
+		current.rows(results);
+}
+
+void BPlusTree::searchPrefix(std::string_view prefix, std::vector<Wine*>& results) const
+{
+	// Keys starting with prefix are contiguous and none of them is less than prefix.
+	for (Iterator current = lowerBound(prefix); current != end() && current.key().substr(0, prefix.size()) == prefix; ++current)
+		current.rows(results);
+}
+
+int BPlusTree::size() const
+{
+	return numKeys;
+}
+
+int BPlusTree::getHeight() const
+{
+	return height;
+}
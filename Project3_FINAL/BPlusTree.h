@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include "Wine.h"
+#include "Arena.h"
+
+// Ordered index with wide nodes. Every node keeps its keys' first 8 bytes as big-endian integers in one
+// contiguous array next to the key views, so most comparisons on the way down touch only that node
+// rather than a Wine and its string. Leaves are linked left to right for in-order scans.
+// Searches return the same wines in the same order as RedBlackTree.
+class BPlusTree
+{
+private:
+	// Keys per node; a node splits in half when it would exceed this.
+	static constexpr int MAX_KEYS = 31;
+
+	// Struct for chaining duplicate keys:
+	struct duplicateNode
+	{
+		Wine* data;
+		duplicateNode* next;
+		duplicateNode(Wine* _data, duplicateNode* _next) : data(_data), next(_next) {}
+	};
+
+	struct Node
+	{
+		bool isLeaf;
+		int count;
+		uint64_t prefixes[MAX_KEYS];
+		std::string_view keys[MAX_KEYS];
+		Node(bool _isLeaf) : isLeaf(_isLeaf), count(0) { }
+	};
+
+	// children[i] holds the keys below keys[i]; children[count] the rest.
+	struct InnerNode : Node
+	{
+		Node* children[MAX_KEYS + 1];
+		InnerNode() : Node(false) { }
+	};
+
+	// rows[i] is the first wine inserted with keys[i], later ones are pushed onto the front of duplicates[i].
+	struct LeafNode : Node
+	{
+		Wine* rows[MAX_KEYS];
+		duplicateNode* duplicates[MAX_KEYS];
+		LeafNode* next;
+		LeafNode() : Node(true), next(nullptr) { }
+	};
+
+	// A node split off during insertion, to be linked into the parent under separator.
+	struct Split
+	{
+		Node* right;
+		uint64_t prefix;
+		std::string_view separator;
+	};
+
+	Node* root;
+	// Every node is bump allocated here and released together with the tree.
+	Arena nodeArena;
+	// Returns a view of the key the tree orders by.
+	std::string_view(Wine::* getKey)() const;
+	int numKeys;
+	int height;
+
+	// First 8 bytes of key as a big-endian integer, zero padded, so integer order matches string order.
+	static uint64_t keyPrefix(std::string_view key);
+	// Three-way comparison of the node's key at index with key, falling back to the full strings on equal prefixes.
+	static int compareAt(const Node* node, int index, uint64_t prefix, std::string_view key);
+	// Index of the first key in node that isn't less than key.
+	static int lowerIndex(const Node* node, uint64_t prefix, std::string_view key);
+
+	// Inserts into node's subtree. Returns true and fills split if node had to split.
+	bool insertInto(Node* node, Wine* w, uint64_t prefix, std::string_view key, Split& split);
+	const LeafNode* findLeaf(uint64_t prefix, std::string_view key, int& index) const;
+public:
+	// Walks the distinct keys in ascending order along the leaf chain. Stays valid until the next insert.
+	class Iterator
+	{
+	private:
+		const LeafNode* leaf;
+		int index;
+	public:
+		Iterator(const LeafNode* _leaf = nullptr, int _index = 0);
+
+		std::string_view key() const;
+		// Appends the wines with this key, in the order search() returns them.
+		void rows(std::vector<Wine*>& results) const;
+
+		Iterator& operator++();
+		bool operator==(const Iterator& other) const;
+		bool operator!=(const Iterator& other) const;
+	};
+
+	BPlusTree(Wine::Properties _searchBy);
+	~BPlusTree(); // Nodes live in nodeArena, so they are freed all at once.
+
+	void insert(Wine* w);
+	void search(Wine* key, std::vector<Wine*>& results); // Search returns a vector of all matching results.
+	void search(std::string_view key, std::vector<Wine*>& results) const; // Same as above without needing a key Wine.
+
+	Iterator begin() const;
+	Iterator end() const;
+	// First key that isn't less than key, or end().
+	Iterator lowerBound(std::string_view key) const;
+	// First key greater than key, or end().
+	Iterator upperBound(std::string_view key) const;
+
+	// Appends the wines of every key in [low, high], in key order. O(log n + k).
+	void searchRange(std::string_view low, std::string_view high, std::vector<Wine*>& results) const;
+	// Appends the wines of every key starting with prefix, in key order. O(log n + k).
+	void searchPrefix(std::string_view prefix, std::vector<Wine*>& results) const;
+
+	int size() const; // Number of distinct keys.
+	int getHeight() const; // Levels from the root to the leaves (0 when empty).
+};
@@ -0,0 +1,318 @@
+#include "Batch.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	const int NUM_PROPERTIES = 7;
+
+	struct Query {
+		size_t line;
+		Wine::Properties property;
+		IndexManager::Structure structure;
+		string key;
+		Wine::Properties sortBy;
+		size_t limit;
+		// Why the line couldn't be parsed; empty for a valid query.
+		string error;
+	};
+
+	// The indexes shared by every worker, looked up once so that queries don't go through IndexManager's lock.
+	struct Indexes {
+		RedBlackTree* trees[NUM_PROPERTIES] = {};
+		HashTable* hashTables[NUM_PROPERTIES] = {};
+		BPlusTree* bPlusTrees[NUM_PROPERTIES] = {};
+		FlatHashTable* flatHashTables[NUM_PROPERTIES] = {};
+	};
+
+	bool parseProperty(const string& name, Wine::Properties& property)
+	{
+		if (name == "variety")
+			property = Wine::Properties::VARIETY;
+		else if (name == "country")
+			property = Wine::Properties::COUNTRY;
+		else if (name == "title")
+			property = Wine::Properties::TITLE;
+		else if (name == "province")
+			property = Wine::Properties::PROVINCE;
+		else
+			return false;
+		return true;
+	}
+
+	bool parseStructure(const string& name, IndexManager::Structure& structure)
+	{
+		if (name == "rbt")
+			structure = IndexManager::Structure::RED_BLACK_TREE;
+		else if (name == "hash")
+			structure = IndexManager::Structure::HASH_TABLE;
+		else if (name == "bplus")
+			structure = IndexManager::Structure::B_PLUS_TREE;
+		else if (name == "flat")
+			structure = IndexManager::Structure::FLAT_HASH_TABLE;
+		else
+			return false;
+		return true;
+	}
+
+	bool parseSort(const string& name, Wine::Properties& sortBy)
+	{
+		if (name.empty() || name == "none")
+			sortBy = Wine::Properties::NONE;
+		else if (name == "price")
+			sortBy = Wine::Properties::PRICE;
+		else if (name == "rating")
+			sortBy = Wine::Properties::RATING;
+		else
+			return false;
+		return true;
+	}
+
+	Query parseQuery(const string& text, size_t line)
+	{
+		Query query{ line, Wine::Properties::NONE, IndexManager::Structure::RED_BLACK_TREE, "", Wine::Properties::NONE, 0, "" };
+		vector<string> fields;
+		size_t start = 0;
+		while (true) {
+			size_t tab = text.find('\t', start);
+			fields.push_back(text.substr(start, tab == string::npos ? string::npos : tab - start));
+			if (tab == string::npos)
+				break;
+			start = tab + 1;
+		}
+
+		if (fields.size() < 3 || fields.size() > 5)
+			query.error = "expected 3 to 5 tab separated fields";
+		else if (!parseProperty(fields[0], query.property))
+			query.error = "unknown property '" + fields[0] + "'";
+		else if (!parseStructure(fields[1], query.structure))
+			query.error = "unknown structure '" + fields[1] + "'";
+		else if (!parseSort(fields.size() > 3 ? fields[3] : "", query.sortBy))
+			query.error = "unknown sort '" + fields[3] + "'";
+		else if (fields.size() > 4 && (fields[4].empty() || fields[4].find_first_not_of("0123456789") != string::npos))
+			query.error = "invalid limit '" + fields[4] + "'";
+		else {
+			query.key = fields[2];
+			if (fields.size() > 4) {
+				// Digits only, but the value can still be too large for a size_t.
+				try {
+					query.limit = (size_t)stoull(fields[4]);
+				}
+				catch (const out_of_range&) {
+					query.error = "invalid limit '" + fields[4] + "'";
+				}
+			}
+		}
+		return query;
+	}
+
+	// Appends s as a quoted JSON string.
+	void writeString(ostream& output, std::string_view s)
+	{
+		output << '"';
+		for (char c : s) {
+			switch (c) {
+			case '"':
+				output << "\\\"";
+				break;
+			case '\\':
+				output << "\\\\";
+				break;
+			case '\n':
+				output << "\\n";
+				break;
+			case '\r':
+				output << "\\r";
+				break;
+			case '\t':
+				output << "\\t";
+				break;
+			default:
+				if ((unsigned char)c < 0x20)
+					output << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+				else
+					output << c;
+			}
+		}
+		output << '"';
+	}
+
+	void writeWine(ostream& output, const Wine* wine)
+	{
+		output << "{\"title\":";
+		writeString(output, wine->getTitleView());
+		output << ",\"country\":";
+		writeString(output, wine->getCountryView());
+		output << ",\"province\":";
+		writeString(output, wine->getProvinceView());
+		output << ",\"variety\":";
+		writeString(output, wine->getVarietyView());
+		output << ",\"price\":";
+		if (wine->getPrice() == 0)
+			output << "null";
+		else
+			output << wine->getPrice();
+		output << ",\"rating\":" << wine->getRating() << "}";
+	}
+
+	// Runs query and returns its JSON line; seconds is set to the time spent searching and sorting.
+	string runQuery(const Query& query, const Indexes& indexes, double& seconds)
+	{
+		ostringstream output;
+		output << "{\"line\":" << query.line;
+		if (!query.error.empty()) {
+			output << ",\"error\":";
+			writeString(output, query.error);
+			output << "}";
+			seconds = 0;
+			return output.str();
+		}
+
+		auto start = chrono::steady_clock::now();
+		vector<Wine*> results;
+		int property = (int)query.property;
+		switch (query.structure) {
+		case IndexManager::Structure::RED_BLACK_TREE:
+			indexes.trees[property]->search(query.key, results);
+			break;
+		case IndexManager::Structure::HASH_TABLE:
+			indexes.hashTables[property]->search(query.key, results);
+			break;
+		case IndexManager::Structure::B_PLUS_TREE:
+			indexes.bPlusTrees[property]->search(query.key, results);
+			break;
+		case IndexManager::Structure::FLAT_HASH_TABLE:
+			indexes.flatHashTables[property]->search(query.key, results);
+			break;
+		}
+		size_t count = query.limit == 0 ? results.size() : min(query.limit, results.size());
+		if (query.sortBy != Wine::Properties::NONE)
+			Wine::sortTopWine(results, query.sortBy, count);
+		auto stop = chrono::steady_clock::now();
+		seconds = chrono::duration<double>(stop - start).count();
+
+		output << ",\"matches\":" << results.size() << ",\"micros\":" << fixed << setprecision(2) << seconds * 1e6 << ",\"wines\":[";
+		for (size_t i = 0; i < count; i++) {
+			if (i > 0)
+				output << ",";
+			writeWine(output, results[i]);
+		}
+		output << "]}";
+		return output.str();
+	}
+
+	// Nearest-rank percentile of sorted values.
+	double percentile(const vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+			return 0;
+		size_t rank = (size_t)ceil(fraction * sorted.size());
+		return sorted[min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+	}
+}
+
+size_t Batch::run(istream& input, ostream& output, ostream& log, IndexManager& indexes, unsigned numThreads)
+{
+	vector<Query> queries;
+	string text;
+	size_t errors = 0;
+	for (size_t line = 1; getline(input, text); line++) {
+		if (!text.empty() && text.back() == '\r')
+			text.pop_back();
+		if (text.empty() || text[0] == '#')
+			continue;
+		queries.push_back(parseQuery(text, line));
+		if (!queries.back().error.empty())
+			errors++;
+	}
+
+	// Builds every index the queries use up front, so the workers only ever read them.
+	Indexes shared;
+	auto buildStart = chrono::steady_clock::now();
+	for (const Query& query : queries) {
+		if (!query.error.empty())
+			continue;
+		int property = (int)query.property;
+		switch (query.structure) {
+		case IndexManager::Structure::RED_BLACK_TREE:
+			if (shared.trees[property] == nullptr)
+				shared.trees[property] = &indexes.getTree(query.property);
+			break;
+		case IndexManager::Structure::HASH_TABLE:
+			if (shared.hashTables[property] == nullptr)
+				shared.hashTables[property] = &indexes.getHashTable(query.property);
+			break;
+		case IndexManager::Structure::B_PLUS_TREE:
+			if (shared.bPlusTrees[property] == nullptr)
+				shared.bPlusTrees[property] = &indexes.getBPlusTree(query.property);
+			break;
+		case IndexManager::Structure::FLAT_HASH_TABLE:
+			if (shared.flatHashTables[property] == nullptr)
+				shared.flatHashTables[property] = &indexes.getFlatHashTable(query.property);
+			break;
+		}
+	}
+	auto buildStop = chrono::steady_clock::now();
+
+	// Workers take queries in input order; results are kept per query so they can be written in that order.
+	numThreads = max(1u, numThreads);
+	vector<string> lines(queries.size());
+	vector<double> latencies(queries.size());
+	atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i = next++; i < queries.size(); i = next++)
+			lines[i] = runQuery(queries[i], shared, latencies[i]);
+	};
+	auto start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (unsigned i = 1; i < numThreads; i++)
+		workers.emplace_back(work);
+	work();
+	for (thread& worker : workers)
+		worker.join();
+	auto stop = chrono::steady_clock::now();
+
+	for (const string& line : lines)
+		output << line << '\n';
+
+	vector<double> sorted;
+	double total = 0;
+	for (size_t i = 0; i < queries.size(); i++) {
+		if (queries[i].error.empty()) {
+			sorted.push_back(latencies[i] * 1e6);
+			total += latencies[i] * 1e6;
+		}
+	}
+	sort(sorted.begin(), sorted.end());
+	double seconds = chrono::duration<double>(stop - start).count();
+	double qps = seconds > 0 ? sorted.size() / seconds : 0;
+	double mean = sorted.empty() ? 0 : total / sorted.size();
+	const double FRACTIONS[] = { 0.5, 0.9, 0.99, 0.999 };
+	const char* const NAMES[] = { "p50", "p90", "p99", "p999" };
+
+	output << fixed << setprecision(2) << "{\"summary\":{\"queries\":" << sorted.size() << ",\"errors\":" << errors
+		<< ",\"threads\":" << numThreads << setprecision(6) << ",\"buildSeconds\":" << chrono::duration<double>(buildStop - buildStart).count()
+		<< ",\"seconds\":" << seconds << setprecision(2) << ",\"qps\":" << qps << ",\"micros\":{\"mean\":" << mean;
+	for (int i = 0; i < 4; i++)
+		output << ",\"" << NAMES[i] << "\":" << percentile(sorted, FRACTIONS[i]);
+	output << ",\"max\":" << (sorted.empty() ? 0 : sorted.back()) << "}}}" << endl;
+	output.unsetf(ios::floatfield);
+
+	log << fixed << setprecision(2) << "Ran " << sorted.size() << " queries (" << errors << " invalid) on " << numThreads
+		<< " threads in " << seconds * 1000.0 << " ms: " << qps << " queries/s." << endl;
+	log << "Latency (us): mean " << mean;
+	for (int i = 0; i < 4; i++)
+		log << ", " << NAMES[i] << " " << percentile(sorted, FRACTIONS[i]);
+	log << ", max " << (sorted.empty() ? 0 : sorted.back()) << endl;
+	log.unsetf(ios::floatfield);
+	return errors;
+}
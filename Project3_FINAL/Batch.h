@@ -0,0 +1,23 @@
+#pragma once
+#include <istream>
+#include <ostream>
+#include "IndexManager.h"
+
+// Non-interactive query mode, run with the --batch command line flag instead of the interactive menu.
+//
+// Reads one query per line as tab separated fields:
+//     property  structure  key  [sort  [limit]]
+// property is variety, country, title or province; structure is rbt, hash, bplus or flat (FlatHashTable);
+// sort is none (the default), price or rating; limit caps the wines written per query (0, the default, writes all).
+// Blank lines and lines starting with '#' are skipped.
+//
+// Every index the queries need is built first, then the queries run on a pool of threads that share
+// the indexes read-only. Results are written in input order as JSON Lines, one object per query:
+//     {"line":1,"matches":3,"micros":1.25,"wines":[{"title":...,"country":...,"province":...,"variety":...,"price":...,"rating":...}]}
+// or {"line":1,"error":"..."} for a line that can't be parsed, followed by one {"summary":...} object
+// with the query count, queries per second and latency percentiles.
+namespace Batch {
+	// Runs every query in input on numThreads threads and writes the results to output.
+	// A summary for people is also written to log. Returns the number of lines that couldn't be parsed.
+	size_t run(std::istream& input, std::ostream& output, std::ostream& log, IndexManager& indexes, unsigned numThreads);
+}
@@ -0,0 +1,911 @@
+#include "Benchmark.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Arena.h"
+#include "BPlusTree.h"
+#include "CSVReader.h"
+#include "FlatHashTable.h"
+#include "HashTable.h"
+#include "MappedFile.h"
+#include "RedBlackTree.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+	const int REPETITIONS = 5;
+
+	const Wine::Properties STRING_PROPERTIES[] = { Wine::Properties::VARIETY, Wine::Properties::COUNTRY,
+		Wine::Properties::TITLE, Wine::Properties::PROVINCE };
+	const char* const PROPERTY_NAMES[] = { "none", "variety", "country", "title", "province", "rating", "price" };
+
+	// Runs work once to warm up, then REPETITIONS times, and prints the fastest and mean time.
+	// Throughput is shown when megabytes is given, and time per operation when operations is.
+	// Returns the fastest time in seconds.
+	double timeIt(const string& name, const function<size_t()>& work, double megabytes = 0, size_t operations = 0)
+	{
+		size_t checksum = work();
+		double best = 0, total = 0;
+		for (int i = 0; i < REPETITIONS; i++) {
+			auto start = chrono::high_resolution_clock::now();
+			checksum += work();
+			auto stop = chrono::high_resolution_clock::now();
+			double seconds = chrono::duration<double>(stop - start).count();
+			total += seconds;
+			if (i == 0 || seconds < best)
+				best = seconds;
+		}
+		cout << "  " << left << setw(36) << name << right << fixed << setprecision(2)
+			<< setw(10) << best * 1000.0 << " ms best" << setw(10) << total / REPETITIONS * 1000.0 << " ms mean";
+		if (megabytes > 0)
+			cout << setw(10) << megabytes / best << " MB/s";
+		if (operations > 0)
+			cout << setw(10) << best * 1e9 / operations << " ns/op";
+		cout << "  (checksum " << checksum << ")" << endl;
+		cout.unsetf(ios::floatfield);
+		return best;
+	}
+
+	// Bytes of physical memory used by the process, or 0 where unsupported.
+	size_t residentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.WorkingSetSize;
+		return 0;
+#elif defined(__linux__)
+		ifstream statm("/proc/self/statm");
+		size_t totalPages = 0, residentPages = 0;
+		statm >> totalPages >> residentPages;
+		return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+		return 0;
+#endif
+	}
+
+	// Returns an empty Index over property of the wines in store.
+	template <class Index>
+	Index* newIndex(WineStore&, Wine::Properties property)
+	{
+		return new Index(property);
+	}
+
+	// The two indexes that are specialized per property come from their factories.
+	template <>
+	RedBlackTree* newIndex<RedBlackTree>(WineStore&, Wine::Properties property)
+	{
+		return RedBlackTree::create(property).release();
+	}
+
+	template <>
+	HashTable* newIndex<HashTable>(WineStore& store, Wine::Properties property)
+	{
+		return HashTable::create(property, store.estimateDistinct(property)).release();
+	}
+
+	// FlatHashTable keeps row ids, so it needs the store they belong to.
+	template <>
+	FlatHashTable* newIndex<FlatHashTable>(WineStore& store, Wine::Properties property)
+	{
+		return new FlatHashTable(store, property, store.estimateDistinct(property));
+	}
+
+	// Hardware cache miss counters for the calling thread, read through Linux perf events. available() is false
+	// where they can't be opened (other platforms, most virtual machines), and every count is then 0.
+	class CacheCounters {
+	private:
+		static const int NUM_COUNTERS = 2;
+		int descriptors[NUM_COUNTERS];
+	public:
+		CacheCounters()
+		{
+#ifdef __linux__
+			// L1 data cache read misses, then last level cache misses.
+			const uint32_t TYPES[NUM_COUNTERS] = { PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+			const uint64_t CONFIGS[NUM_COUNTERS] = {
+				PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+				PERF_COUNT_HW_CACHE_MISSES };
+			for (int i = 0; i < NUM_COUNTERS; i++) {
+				perf_event_attr attributes = {};
+				attributes.size = sizeof(attributes);
+				attributes.type = TYPES[i];
+				attributes.config = CONFIGS[i];
+				attributes.disabled = 1;
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				descriptors[i] = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+			}
+#else
+			for (int i = 0; i < NUM_COUNTERS; i++)
+				descriptors[i] = -1;
+#endif
+		}
+
+		~CacheCounters()
+		{
+#ifdef __linux__
+			for (int descriptor : descriptors) {
+				if (descriptor >= 0)
+					close(descriptor);
+			}
+#endif
+		}
+
+		bool available() const
+		{
+			return descriptors[0] >= 0 && descriptors[1] >= 0;
+		}
+
+		void start()
+		{
+#ifdef __linux__
+			for (int descriptor : descriptors) {
+				if (descriptor >= 0) {
+					ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+					ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+				}
+			}
+#endif
+		}
+
+		// Reads the L1 data cache read misses and last level cache misses since start().
+		void stop(uint64_t& l1Misses, uint64_t& lastLevelMisses)
+		{
+			uint64_t counts[NUM_COUNTERS] = {};
+#ifdef __linux__
+			for (int i = 0; i < NUM_COUNTERS; i++) {
+				if (descriptors[i] < 0)
+					continue;
+				ioctl(descriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+				if (read(descriptors[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+					counts[i] = 0;
+			}
+#endif
+			l1Misses = counts[0];
+			lastLevelMisses = counts[1];
+		}
+	};
+
+	// Builds an Index over every wine.
+	template <class Index>
+	Index* buildIndex(WineStore& store, Wine::Properties property)
+	{
+		Index* index = newIndex<Index>(store, property);
+		for (WineStore::RowId id = 0; id < store.size(); id++)
+			index->insert(store[id]);
+		return index;
+	}
+
+	// Times building an Index over every wine and destroying it again, separately.
+	void buildAndTeardown(const string& name, const function<void()>& build, const function<void()>& teardown)
+	{
+		double bestBuild = 0, bestTeardown = 0;
+		for (int i = 0; i < REPETITIONS; i++) {
+			auto start = chrono::high_resolution_clock::now();
+			build();
+			auto built = chrono::high_resolution_clock::now();
+			teardown();
+			auto stop = chrono::high_resolution_clock::now();
+
+			double buildTime = chrono::duration<double>(built - start).count();
+			double teardownTime = chrono::duration<double>(stop - built).count();
+			if (i == 0 || buildTime < bestBuild)
+				bestBuild = buildTime;
+			if (i == 0 || teardownTime < bestTeardown)
+				bestTeardown = teardownTime;
+		}
+		cout << "  " << left << setw(36) << name << right << fixed << setprecision(2)
+			<< setw(10) << bestBuild * 1000.0 << " ms build" << setw(10) << bestTeardown * 1000.0 << " ms teardown" << endl;
+		cout.unsetf(ios::floatfield);
+	}
+
+	// count keys drawn uniformly from the distinct values of property, so that a few huge
+	// result sets don't dominate hit timings. Misses get a suffix no key has.
+	vector<string> sampleKeys(WineStore& store, Wine::Properties property, size_t count, bool misses)
+	{
+		unordered_set<std::string_view> seen;
+		vector<std::string_view> distinct;
+		for (WineStore::RowId i = 0; i < store.size(); i++) {
+			if (seen.insert(store[i]->getValueView(property)).second)
+				distinct.push_back(store[i]->getValueView(property));
+		}
+
+		vector<string> keys;
+		if (distinct.empty())
+			return keys;
+		mt19937 generator(42);
+		uniform_int_distribution<size_t> pick(0, distinct.size() - 1);
+		keys.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			keys.emplace_back(distinct[pick(generator)]);
+			if (misses)
+				keys.back() += "\x01";
+		}
+		return keys;
+	}
+
+	// Timing statistics over repeated runs, in nanoseconds per operation.
+	struct Stats {
+		double min, median, mean, deviation, max;
+	};
+
+	// Runs work warmups times untimed, then repetitions times, and summarizes the timed runs.
+	// checksum accumulates work's results so the compiler can't drop the work.
+	Stats measure(const function<size_t()>& work, size_t operations, int warmups, int repetitions, size_t& checksum)
+	{
+		for (int i = 0; i < warmups; i++)
+			checksum += work();
+		vector<double> samples;
+		for (int i = 0; i < repetitions; i++) {
+			auto start = chrono::high_resolution_clock::now();
+			checksum += work();
+			auto stop = chrono::high_resolution_clock::now();
+			samples.push_back(chrono::duration<double>(stop - start).count() * 1e9 / max<size_t>(1, operations));
+		}
+		sort(samples.begin(), samples.end());
+		Stats stats;
+		stats.min = samples.front();
+		stats.max = samples.back();
+		size_t middle = samples.size() / 2;
+		stats.median = samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+		stats.mean = 0;
+		for (double sample : samples)
+			stats.mean += sample;
+		stats.mean /= samples.size();
+		stats.deviation = 0;
+		for (double sample : samples)
+			stats.deviation += (sample - stats.mean) * (sample - stats.mean);
+		stats.deviation = samples.size() > 1 ? sqrt(stats.deviation / (samples.size() - 1)) : 0;
+		return stats;
+	}
+
+	// Fills store with size wines by repeating base's rows in order. Every repetition after the first appends
+	// " #<repetition>" to its titles, so titles stay (mostly) unique while the other columns keep base's distribution.
+	void scaleStore(WineStore& base, size_t size, WineStore& store)
+	{
+		store.clear();
+		store.reserve(size);
+		string title;
+		for (size_t i = 0; i < size; i++) {
+			WineStore::RowId id = (WineStore::RowId)(i % base.size());
+			size_t repetition = i / base.size();
+			title.assign(base.getTitle(id));
+			if (repetition > 0)
+				title += " #" + to_string(repetition);
+			WineRecord record{ title, base.getCountry(id), base.getVariety(id), base.getProvince(id), base.getPrice(id), base.getRating(id) };
+			store.append(record);
+		}
+		store.finalize();
+	}
+
+	// count keys drawn from the distinct values of property with Zipf's law (exponent 1): the value held
+	// by the most wines is asked for most, the second half as often, and so on.
+	vector<string> zipfKeys(WineStore& store, Wine::Properties property, size_t count)
+	{
+		unordered_map<std::string_view, size_t> frequencies;
+		for (WineStore::RowId i = 0; i < store.size(); i++)
+			frequencies[store[i]->getValueView(property)]++;
+		vector<pair<size_t, std::string_view>> ranked;
+		for (const auto& entry : frequencies)
+			ranked.emplace_back(entry.second, entry.first);
+		sort(ranked.begin(), ranked.end(), [](const pair<size_t, std::string_view>& a, const pair<size_t, std::string_view>& b) {
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+
+		vector<string> keys;
+		if (ranked.empty())
+			return keys;
+		vector<double> weights(ranked.size());
+		for (size_t rank = 0; rank < ranked.size(); rank++)
+			weights[rank] = 1.0 / (rank + 1);
+		mt19937 generator(42);
+		discrete_distribution<size_t> pick(weights.begin(), weights.end());
+		keys.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			keys.emplace_back(ranked[pick(generator)].second);
+		return keys;
+	}
+
+	// Appends s as a quoted JSON string, escaped the way batch mode's output is.
+	void writeString(ostream& output, std::string_view s)
+	{
+		output << '"';
+		for (char c : s) {
+			switch (c) {
+			case '"':
+				output << "\\\"";
+				break;
+			case '\\':
+				output << "\\\\";
+				break;
+			case '\n':
+				output << "\\n";
+				break;
+			case '\r':
+				output << "\\r";
+				break;
+			case '\t':
+				output << "\\t";
+				break;
+			default:
+				if ((unsigned char)c < 0x20)
+					output << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+				else
+					output << c;
+			}
+		}
+		output << '"';
+	}
+
+	// Writes the suite's results as a JSON array of objects, one per measurement.
+	class SuiteReport {
+	private:
+		ostringstream json;
+		size_t numResults = 0;
+	public:
+		void add(size_t size, const string& property, const string& index, const string& operation, size_t operations,
+			const Stats& stats, size_t checksum)
+		{
+			cout << "  " << left << setw(40) << property + " " + index + " " + operation << right << fixed << setprecision(2)
+				<< setw(10) << stats.median << " ns/op median" << setw(10) << stats.min << " min" << setw(10) << stats.mean
+				<< " mean" << setw(8) << (stats.mean > 0 ? stats.deviation / stats.mean * 100.0 : 0.0) << "% sd" << endl;
+			cout.unsetf(ios::floatfield);
+
+			json << (numResults++ == 0 ? "\n    " : ",\n    ") << fixed << setprecision(3)
+				<< "{\"size\": " << size << ", \"property\": \"" << property << "\", \"index\": \"" << index
+				<< "\", \"operation\": \"" << operation << "\", \"operations\": " << operations
+				<< ", \"nsPerOp\": {\"min\": " << stats.min << ", \"median\": " << stats.median << ", \"mean\": " << stats.mean
+				<< ", \"stddev\": " << stats.deviation << ", \"max\": " << stats.max << "}, \"checksum\": " << checksum << "}";
+		}
+
+		bool write(const string& path, const string& csvPath, int warmups, int repetitions, size_t lookups) const
+		{
+			ofstream file(path);
+			file << "{\n  \"csv\": ";
+			// Windows paths are full of backslashes.
+			writeString(file, csvPath);
+			file << ",\n  \"warmups\": " << warmups << ",\n  \"repetitions\": " << repetitions
+				<< ",\n  \"lookups\": " << lookups << ",\n  \"results\": [" << json.str() << "\n  ]\n}\n";
+			return (bool)file;
+		}
+	};
+
+	// Builds a HashTable hashed by Hash over every wine.
+	template <class Hash>
+	HashTable* buildHashTable(WineStore& store, Wine::Properties property)
+	{
+		HashTable* table = HashTable::create<Hash>(property, store.estimateDistinct(property)).release();
+		for (WineStore::RowId id = 0; id < store.size(); id++)
+			table->insert(store[id]);
+		return table;
+	}
+
+	// Times Hash over keys and measures a HashTable hashed by it built over every wine in store for property.
+	template <class Hash>
+	void hashPolicy(WineStore& store, Wine::Properties property, const vector<std::string_view>& keys, double megabytes)
+	{
+		string name = string(PROPERTY_NAMES[(int)property]) + " " + Hash::NAME;
+		timeIt(name + " hash", [&]() {
+			uint64_t checksum = 0;
+			for (std::string_view key : keys)
+				checksum += Hash::hash(key);
+			return (size_t)checksum;
+		}, megabytes, keys.size());
+		timeIt(name + " build", [&]() {
+			delete buildHashTable<Hash>(store, property);
+			return (size_t)0;
+		}, 0, store.size());
+
+		HashTable* table = buildHashTable<Hash>(store, property);
+		vector<Wine*> results;
+		timeIt(name + " hit", [&]() {
+			size_t found = 0;
+			for (std::string_view key : keys) {
+				results.clear();
+				table->search(key, results);
+				found += results.size();
+			}
+			return found;
+		}, 0, keys.size());
+		cout << "  " << left << setw(36) << name + " probe length" << right << fixed << setprecision(3)
+			<< setw(10) << table->averageProbeLength() << " slots mean" << setw(10) << table->capacity() << " slots" << endl;
+		cout.unsetf(ios::floatfield);
+		delete table;
+	}
+
+	// Times building the Index returned by create with one insert per wine in store, then looking up hits and misses.
+	template <class Index>
+	void insertAndSearch(const string& name, WineStore& store, const function<Index*()>& create, const vector<string>& hits,
+		const vector<string>& misses)
+	{
+		timeIt(name + " build", [&]() {
+			unique_ptr<Index> index(create());
+			for (WineStore::RowId id = 0; id < store.size(); id++)
+				index->insert(store[id]);
+			return (size_t)0;
+		}, 0, store.size());
+
+		unique_ptr<Index> index(create());
+		for (WineStore::RowId id = 0; id < store.size(); id++)
+			index->insert(store[id]);
+		vector<Wine*> results;
+		for (const vector<string>* keys : { &hits, &misses }) {
+			timeIt(name + (keys == &hits ? " hit" : " miss"), [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					index->search(key, results);
+					found += results.size();
+				}
+				return found;
+			}, 0, keys->size());
+		}
+	}
+
+	// Measures building Index over every wine in store and searching it with hit, miss and Zipfian keys.
+	template <class Index>
+	void suiteIndex(SuiteReport& report, WineStore& store, Wine::Properties property, const string& name,
+		const vector<string>* keySets[3], int warmups, int repetitions)
+	{
+		const char* const OPERATIONS[] = { "hit", "miss", "zipf" };
+		const size_t RESULT_BUDGET = 1000000;
+		const size_t MIN_KEYS = 100;
+		string propertyName = PROPERTY_NAMES[(int)property];
+		size_t checksum = 0;
+		// Large builds are slow and steady, so they are repeated less.
+		int buildRepetitions = store.size() >= 1000000 ? max(1, repetitions / 2) : repetitions;
+		Stats stats = measure([&]() {
+			delete buildIndex<Index>(store, property);
+			return (size_t)0;
+		}, store.size(), min(warmups, 1), buildRepetitions, checksum);
+		report.add(store.size(), propertyName, name, "build", store.size(), stats, checksum);
+
+		Index* index = buildIndex<Index>(store, property);
+		vector<Wine*> results;
+		for (int kind = 0; kind < 3; kind++) {
+			// Keys matching many wines would time copying them out rather than the lookup, so a run stops
+			// once its keys have matched RESULT_BUDGET wines (but never before MIN_KEYS keys).
+			const vector<string>& keys = *keySets[kind];
+			size_t numKeys = 0;
+			for (size_t matched = 0; numKeys < keys.size() && (numKeys < MIN_KEYS || matched < RESULT_BUDGET); numKeys++) {
+				results.clear();
+				index->search(keys[numKeys], results);
+				matched += results.size();
+			}
+			checksum = 0;
+			stats = measure([&]() {
+				size_t found = 0;
+				for (size_t i = 0; i < numKeys; i++) {
+					results.clear();
+					index->search(keys[i], results);
+					found += results.size();
+				}
+				return found;
+			}, numKeys, warmups, repetitions, checksum);
+			report.add(store.size(), propertyName, name, OPERATIONS[kind], numKeys, stats, checksum);
+		}
+		delete index;
+	}
+}
+
+void Benchmark::runAll(const string& csvPath)
+{
+	csvParsing(csvPath);
+
+	WineStore store;
+	size_t fileSize;
+	if (!store.loadCSV(csvPath, 1, fileSize))
+		return;
+	indexLifecycle(store);
+	treeBulkLoad(store);
+	orderedIndexes(store);
+	hashIndexes(store);
+	hashPolicies(store);
+	specializedIndexes(store);
+	treeCacheMisses(store);
+	resultSorting(store);
+}
+
+void Benchmark::csvParsing(const string& csvPath)
+{
+	MappedFile file;
+	if (!file.open(csvPath)) {
+		cout << "Could not open " << csvPath << endl;
+		return;
+	}
+	double megabytes = file.size() / (1024.0 * 1024.0);
+	cout << "CSV parsing (" << csvPath << ", " << fixed << setprecision(1) << megabytes << " MB)" << endl;
+	cout.unsetf(ios::floatfield);
+
+	// The parsing loop readWineCSV() used before the mapped reader, minus the Wine allocation.
+	// It splits on every comma, so lines with quoted fields (which may hold commas) are skipped.
+	timeIt("getline/istringstream/stoi", [&]() {
+		ifstream stream(csvPath);
+		string line, title, country, variety, province, price, points;
+		size_t checksum = 0;
+		getline(stream, line);
+		while (getline(stream, line)) {
+			if (line.find('"') != string::npos)
+				continue;
+			istringstream fields(line);
+			getline(fields, title, ',');
+			getline(fields, country, ',');
+			getline(fields, variety, ',');
+			getline(fields, province, ',');
+			getline(fields, price, ',');
+			getline(fields, points, ',');
+			checksum += title.size() + stoi(price) + stoi(points);
+		}
+		return checksum;
+	}, megabytes);
+
+	for (bool vectorized : { false, true }) {
+		timeIt(vectorized ? "CSVReader (SIMD)" : "CSVReader (scalar)", [&]() {
+			Arena arena;
+			CSVReader reader(file.begin(), file.end(), arena, vectorized);
+			WineRecord record;
+			size_t checksum = 0;
+			reader.skipLine();
+			while (reader.next(record))
+				checksum += record.title.size() + record.price + record.points;
+			return checksum;
+		}, megabytes);
+	}
+	cout << endl;
+}
+
+void Benchmark::hashIndexes(WineStore& store)
+{
+	const size_t LOOKUPS = 20000;
+	cout << "Hash indexes (" << store.size() << " wines, " << LOOKUPS << " lookups)" << endl;
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		vector<string> hits = sampleKeys(store, property, LOOKUPS, false);
+		vector<string> misses = sampleKeys(store, property, LOOKUPS, true);
+
+		timeIt(name + " HashTable build", [&]() {
+			delete buildIndex<HashTable>(store, property);
+			return (size_t)0;
+		}, 0, store.size());
+		timeIt(name + " FlatHashTable build", [&]() {
+			FlatHashTable table(store, property, store.estimateDistinct(property));
+			for (WineStore::RowId i = 0; i < store.size(); i++)
+				table.insert(store[i]);
+			return table.size();
+		}, 0, store.size());
+
+		unique_ptr<HashTable> table(buildIndex<HashTable>(store, property));
+		FlatHashTable flatTable(store, property, store.estimateDistinct(property));
+		for (WineStore::RowId i = 0; i < store.size(); i++)
+			flatTable.insert(store[i]);
+		vector<Wine*> results;
+		for (const vector<string>* keys : { &hits, &misses }) {
+			string kind = keys == &hits ? " hit" : " miss";
+			timeIt(name + " HashTable" + kind, [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					table->search(key, results);
+					found += results.size();
+				}
+				return found;
+			}, 0, keys->size());
+			timeIt(name + " FlatHashTable" + kind, [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					flatTable.search(key, results);
+					found += results.size();
+				}
+				return found;
+			}, 0, keys->size());
+		}
+	}
+	cout << endl;
+}
+
+void Benchmark::hashPolicies(WineStore& store)
+{
+	cout << "Hash policies (" << store.size() << " wines, every distinct value hashed and looked up once)" << endl;
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		unordered_set<std::string_view> seen;
+		vector<std::string_view> keys;
+		size_t bytes = 0;
+		for (WineStore::RowId i = 0; i < store.size(); i++) {
+			std::string_view key = store[i]->getValueView(property);
+			if (seen.insert(key).second) {
+				keys.push_back(key);
+				bytes += key.size();
+			}
+		}
+		double megabytes = bytes / (1024.0 * 1024.0);
+		hashPolicy<TruncatedDjb2Hash>(store, property, keys, megabytes);
+		hashPolicy<Djb2Hash>(store, property, keys, megabytes);
+		hashPolicy<Fnv1aHash>(store, property, keys, megabytes);
+		hashPolicy<WyHash>(store, property, keys, megabytes);
+		hashPolicy<Crc32Hash>(store, property, keys, megabytes);
+	}
+	cout << endl;
+}
+
+void Benchmark::specializedIndexes(WineStore& store)
+{
+	const size_t LOOKUPS = 20000;
+	cout << "Key selection (" << store.size() << " wines, " << LOOKUPS << " lookups)" << endl;
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		vector<string> hits = sampleKeys(store, property, LOOKUPS, false);
+		vector<string> misses = sampleKeys(store, property, LOOKUPS, true);
+		insertAndSearch<RedBlackTree>(name + " RedBlackTree runtime", store,
+			[&]() { return new BasicRedBlackTree<RuntimeKey>(RuntimeKey(property)); }, hits, misses);
+		insertAndSearch<RedBlackTree>(name + " RedBlackTree specialized", store,
+			[&]() { return RedBlackTree::create(property).release(); }, hits, misses);
+		insertAndSearch<HashTable>(name + " HashTable runtime", store,
+			[&]() { return new BasicHashTable<RuntimeKey>(RuntimeKey(property), store.estimateDistinct(property)); }, hits, misses);
+		insertAndSearch<HashTable>(name + " HashTable specialized", store,
+			[&]() { return HashTable::create(property, store.estimateDistinct(property)).release(); }, hits, misses);
+	}
+	cout << endl;
+}
+
+void Benchmark::treeCacheMisses(WineStore& store)
+{
+	const size_t LOOKUPS = 20000;
+	CacheCounters counters;
+	cout << "RedBlackTree lookups (" << store.size() << " wines, " << LOOKUPS << " lookups";
+	if (!counters.available())
+		cout << ", hardware cache counters unavailable";
+	cout << ")" << endl;
+	vector<Wine*> wines = store.getWines();
+
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		vector<string> hits = sampleKeys(store, property, LOOKUPS, false);
+		vector<string> misses = sampleKeys(store, property, LOOKUPS, true);
+		unique_ptr<RedBlackTree> tree = RedBlackTree::create(property);
+		tree->bulkLoad(wines);
+		vector<Wine*> results;
+		for (const vector<string>* keys : { &hits, &misses }) {
+			string kind = keys == &hits ? " hit" : " miss";
+			auto lookUp = [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					tree->search(key, results);
+					found += results.size();
+				}
+				return found;
+			};
+			timeIt(name + kind, lookUp, 0, keys->size());
+			if (counters.available()) {
+				uint64_t l1Misses, lastLevelMisses;
+				counters.start();
+				lookUp();
+				counters.stop(l1Misses, lastLevelMisses);
+				cout << "  " << left << setw(36) << name + kind + " cache misses" << right << fixed << setprecision(2)
+					<< setw(10) << (double)l1Misses / keys->size() << " L1D/op" << setw(10) << (double)lastLevelMisses / keys->size()
+					<< " LLC/op" << endl;
+				cout.unsetf(ios::floatfield);
+			}
+#ifdef INDEX_STATS
+			// One more pass, counted as the difference of the tree's totals around it.
+			TreeStats before = tree->getStats();
+			lookUp();
+			TreeStats after = tree->getStats();
+			cout << "  " << left << setw(36) << name + kind + " key reads" << right << fixed << setprecision(2)
+				<< setw(10) << (double)(after.searchComparisons.total - before.searchComparisons.total) / keys->size()
+				<< " cmp/op" << setw(10) << (double)(after.searchKeyReads.total - before.searchKeyReads.total) / keys->size()
+				<< " reads/op" << endl;
+			cout.unsetf(ios::floatfield);
+#endif
+		}
+	}
+	cout << endl;
+}
+
+void Benchmark::indexLifecycle(WineStore& store)
+{
+	cout << "Index build/teardown (" << store.size() << " wines)" << endl;
+
+	// Every index is kept alive until all have been measured, so the allocator can't hand
+	// freed memory back out and hide an index's RSS growth.
+	vector<RedBlackTree*> trees;
+	vector<HashTable*> tables;
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		size_t before = residentBytes();
+		trees.push_back(buildIndex<RedBlackTree>(store, property));
+		size_t between = residentBytes();
+		tables.push_back(buildIndex<HashTable>(store, property));
+		size_t after = residentBytes();
+		cout << "  " << left << setw(36) << name + " RSS growth" << right << fixed << setprecision(2)
+			<< setw(10) << ((long long)between - (long long)before) / (1024.0 * 1024.0) << " MB RedBlackTree"
+			<< setw(10) << ((long long)after - (long long)between) / (1024.0 * 1024.0) << " MB HashTable" << endl;
+		cout.unsetf(ios::floatfield);
+	}
+	for (RedBlackTree* tree : trees)
+		delete tree;
+	for (HashTable* table : tables)
+		delete table;
+
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		RedBlackTree* tree = nullptr;
+		HashTable* table = nullptr;
+		buildAndTeardown(name + " RedBlackTree", [&]() { tree = buildIndex<RedBlackTree>(store, property); }, [&]() { delete tree; });
+		buildAndTeardown(name + " HashTable", [&]() { table = buildIndex<HashTable>(store, property); }, [&]() { delete table; });
+	}
+	cout << endl;
+}
+
+void Benchmark::treeBulkLoad(WineStore& store)
+{
+	unsigned numThreads = max(2u, thread::hardware_concurrency());
+	cout << "RedBlackTree construction (" << store.size() << " wines)" << endl;
+	vector<Wine*> wines = store.getWines();
+
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		timeIt(name + " insert", [&]() {
+			unique_ptr<RedBlackTree> tree = RedBlackTree::create(property);
+			for (Wine* wine : wines)
+				tree->insert(wine);
+			return (size_t)0;
+		}, 0, wines.size());
+		timeIt(name + " bulkLoad", [&]() {
+			unique_ptr<RedBlackTree> tree = RedBlackTree::create(property);
+			tree->bulkLoad(wines);
+			return (size_t)0;
+		}, 0, wines.size());
+		timeIt(name + " bulkLoad (" + to_string(numThreads) + " threads)", [&]() {
+			unique_ptr<RedBlackTree> tree = RedBlackTree::create(property);
+			tree->bulkLoad(wines, numThreads);
+			return (size_t)0;
+		}, 0, wines.size());
+	}
+	cout << endl;
+}
+
+void Benchmark::orderedIndexes(WineStore& store)
+{
+	const size_t LOOKUPS = 20000;
+	cout << "Ordered indexes (" << store.size() << " wines, " << LOOKUPS << " lookups)" << endl;
+	for (Wine::Properties property : STRING_PROPERTIES) {
+		string name = PROPERTY_NAMES[(int)property];
+		vector<string> hits = sampleKeys(store, property, LOOKUPS, false);
+		vector<string> misses = sampleKeys(store, property, LOOKUPS, true);
+
+		timeIt(name + " RedBlackTree build", [&]() {
+			delete buildIndex<RedBlackTree>(store, property);
+			return (size_t)0;
+		}, 0, store.size());
+		timeIt(name + " BPlusTree build", [&]() {
+			BPlusTree* tree = buildIndex<BPlusTree>(store, property);
+			size_t height = tree->getHeight();
+			delete tree;
+			return height;
+		}, 0, store.size());
+
+		RedBlackTree* tree = buildIndex<RedBlackTree>(store, property);
+		BPlusTree* bPlusTree = buildIndex<BPlusTree>(store, property);
+		vector<Wine*> results;
+		for (const vector<string>* keys : { &hits, &misses }) {
+			string kind = keys == &hits ? " hit" : " miss";
+			timeIt(name + " RedBlackTree" + kind, [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					tree->search(key, results);
+					found += results.size();
+				}
+				return found;
+			}, 0, keys->size());
+			timeIt(name + " BPlusTree" + kind, [&]() {
+				size_t found = 0;
+				for (const string& key : *keys) {
+					results.clear();
+					bPlusTree->search(key, results);
+					found += results.size();
+				}
+				return found;
+			}, 0, keys->size());
+		}
+		delete tree;
+		delete bPlusTree;
+	}
+	cout << endl;
+}
+
+void Benchmark::resultSorting(WineStore& store)
+{
+	unsigned numThreads = max(2u, thread::hardware_concurrency());
+	cout << "Result sorting (" << store.size() << " wines)" << endl;
+	vector<Wine*> wines = store.getWines();
+	vector<Wine*> sorted;
+
+	for (Wine::Properties property : { Wine::Properties::PRICE, Wine::Properties::RATING }) {
+		string name = PROPERTY_NAMES[(int)property];
+		bool (*compare)(const Wine*, const Wine*) = property == Wine::Properties::PRICE ? Wine::priceComp : Wine::ratingComp;
+		// The checksum is the best wine's key, which every variant should agree on.
+		auto bestKey = [&]() {
+			return (size_t)(property == Wine::Properties::PRICE ? sorted.front()->getPrice() : sorted.front()->getRating());
+		};
+		timeIt(name + " std::sort", [&]() {
+			sorted = wines;
+			std::sort(sorted.begin(), sorted.end(), compare);
+			return bestKey();
+		}, 0, wines.size());
+		timeIt(name + " radix sort", [&]() {
+			sorted = wines;
+			Wine::sortWine(sorted, property);
+			return bestKey();
+		}, 0, wines.size());
+		timeIt(name + " radix sort (" + to_string(numThreads) + " threads)", [&]() {
+			sorted = wines;
+			Wine::sortWine(sorted, property, numThreads);
+			return bestKey();
+		}, 0, wines.size());
+	}
+	cout << endl;
+}
+
+void Benchmark::suite(const string& csvPath, const vector<size_t>& sizes, const string& jsonPath)
+{
+	const int WARMUPS = 1;
+	const int SUITE_REPETITIONS = 5;
+	const size_t LOOKUPS = 10000;
+
+	WineStore base;
+	size_t fileSize;
+	if (!base.loadCSV(csvPath, max(1u, thread::hardware_concurrency()), fileSize) || base.empty()) {
+		cout << "Could not open " << csvPath << endl;
+		return;
+	}
+
+	SuiteReport report;
+	for (size_t size : sizes) {
+		WineStore store;
+		scaleStore(base, size, store);
+		cout << "Scaling suite (" << store.size() << " wines, " << LOOKUPS << " lookups per kind)" << endl;
+		for (Wine::Properties property : STRING_PROPERTIES) {
+			vector<string> hits = sampleKeys(store, property, LOOKUPS, false);
+			vector<string> misses = sampleKeys(store, property, LOOKUPS, true);
+			vector<string> zipf = zipfKeys(store, property, LOOKUPS);
+			const vector<string>* keySets[3] = { &hits, &misses, &zipf };
+			suiteIndex<RedBlackTree>(report, store, property, "RedBlackTree", keySets, WARMUPS, SUITE_REPETITIONS);
+			suiteIndex<HashTable>(report, store, property, "HashTable", keySets, WARMUPS, SUITE_REPETITIONS);
+			suiteIndex<FlatHashTable>(report, store, property, "FlatHashTable", keySets, WARMUPS, SUITE_REPETITIONS);
+			suiteIndex<BPlusTree>(report, store, property, "BPlusTree", keySets, WARMUPS, SUITE_REPETITIONS);
+		}
+		cout << endl;
+	}
+
+	if (report.write(jsonPath, csvPath, WARMUPS, SUITE_REPETITIONS, LOOKUPS))
+		cout << "Wrote " << jsonPath << endl;
+	else
+		cout << "Could not write " << jsonPath << endl;
+}
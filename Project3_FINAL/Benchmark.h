@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "WineStore.h"
+
+// Micro benchmarks, run with the --benchmark command line flag instead of the interactive menu.
+namespace Benchmark {
+	// Runs every benchmark against the CSV file at csvPath.
+	void runAll(const std::string& csvPath);
+
+	// Compares the original getline/istringstream/stoi CSV parsing with CSVReader (scalar and vectorized).
+	void csvParsing(const std::string& csvPath);
+
+	// Build time and hit/miss lookup latency of HashTable against FlatHashTable for every string property.
+	void hashIndexes(WineStore& store);
+
+	// Hashing throughput of every HashPolicies.h policy over each string property's distinct values, and the
+	// probe length, build time and hit latency of a BasicHashTable using it.
+	void hashPolicies(WineStore& store);
+
+	// Build time (one insert per wine) and hit/miss lookup latency of RedBlackTree and HashTable reading keys through a member
+	// function pointer (RuntimeKey) against the per-property specializations their factories return.
+	void specializedIndexes(WineStore& store);
+
+	// Hit/miss lookup latency of a bulk loaded RedBlackTree for every string property, with the L1 data cache and
+	// last level cache misses per lookup where the hardware counters can be read (Linux perf events), and the
+	// node comparisons and wine key reads per lookup (a key read is the access that can miss beyond the node)
+	// when built with INDEX_STATS.
+	void treeCacheMisses(WineStore& store);
+
+	// Build time, teardown time and RSS growth of RedBlackTree and HashTable for every string property.
+	void indexLifecycle(WineStore& store);
+
+	// RedBlackTree built by one insert per wine against bulkLoad (single and multi-threaded).
+	void treeBulkLoad(WineStore& store);
+
+	// Build time and hit/miss lookup latency of RedBlackTree against BPlusTree for every string property.
+	void orderedIndexes(WineStore& store);
+
+	// Scaling suite: build time and hit, miss and Zipfian lookup latency of every index structure for every string
+	// property, at each size in sizes (the CSV's wines repeated, each copy with titles of its own). Every
+	// measurement is warmed up and repeated; min, median, mean, standard deviation and max are printed and
+	// written as JSON to jsonPath, so that runs on different commits can be compared.
+	void suite(const std::string& csvPath, const std::vector<size_t>& sizes, const std::string& jsonPath);
+
+	// Ordering every wine by price and by rating with std::sort against Wine::sortWine's radix sort (single and multi-threaded).
+	void resultSorting(WineStore& store);
+}
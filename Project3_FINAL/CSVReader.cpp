@@ -0,0 +1,210 @@
+#include "CSVReader.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSV_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CSV_USE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. mask must not be zero.
+static inline unsigned lowestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctzll(mask);
+#endif
+}
+
+CSVReader::CSVReader(const char* _begin, const char* _end, Arena& _arena, bool _vectorized) :
+	cursor(_begin), end(_end), arena(_arena), blockStart(nullptr), blockMask(0), vectorized(_vectorized) { }
+
+void CSVReader::loadBlock(const char* from)
+{
+	blockStart = from;
+	blockMask = 0;
+	if (end - from < 64 || !vectorized) {
+		size_t length = end - from < 64 ? end - from : 64;
+		for (size_t i = 0; i < length; i++) {
+			char c = from[i];
+			if (c == ',' || c == '"' || c == '\n')
+				blockMask |= (uint64_t)1 << i;
+		}
+		return;
+	}
+#if defined(CSV_USE_AVX2)
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	for (int i = 0; i < 64; i += 32) {
+		__m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + i));
+		__m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, comma), _mm256_cmpeq_epi8(bytes, quote)),
+			_mm256_cmpeq_epi8(bytes, newline));
+		blockMask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(matches) << i;
+	}
+#elif defined(CSV_USE_SSE2)
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i newline = _mm_set1_epi8('\n');
+	for (int i = 0; i < 64; i += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+		__m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, quote)),
+			_mm_cmpeq_epi8(bytes, newline));
+		blockMask |= (uint64_t)(uint16_t)_mm_movemask_epi8(matches) << i;
+	}
+#else
+	for (int i = 0; i < 64; i++) {
+		char c = from[i];
+		if (c == ',' || c == '"' || c == '\n')
+			blockMask |= (uint64_t)1 << i;
+	}
+#endif
+}
+
+const char* CSVReader::findStructural(const char* from)
+{
+	while (from < end) {
+		if (blockStart == nullptr || from < blockStart || from >= blockStart + 64)
+			loadBlock(from);
+		uint64_t mask = blockMask >> (from - blockStart);
+		if (mask != 0)
+			return from + lowestBit(mask);
+		from = blockStart + 64;
+	}
+	return end;
+}
+
+void CSVReader::skipLine()
+{
+	const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+	cursor = newline == nullptr ? end : newline + 1;
+}
+
+bool CSVReader::readField(std::string_view& field, bool& endOfRow)
+{
+	if (cursor >= end || endOfRow)
+		return false;
+
+	if (*cursor == '"') {
+		// Quoted field: runs until a quote that isn't followed by another quote.
+		const char* start = ++cursor;
+		bool escaped = false;
+		while ((cursor = findStructural(cursor)) < end) {
+			if (*cursor == '"') {
+				if (cursor + 1 < end && cursor[1] == '"') {
+					escaped = true;
+					cursor += 2;
+					continue;
+				}
+				break;
+			}
+			cursor++;
+		}
+		field = std::string_view(start, cursor - start);
+		if (cursor < end)
+			cursor++; // Closing quote.
+
+		if (escaped) {
+			char* unescaped = static_cast<char*>(arena.allocate(field.size(), 1));
+			size_t length = 0;
+			for (size_t i = 0; i < field.size(); i++) {
+				unescaped[length++] = field[i];
+				if (field[i] == '"')
+					i++;
+			}
+			field = std::string_view(unescaped, length);
+		}
+		// Anything between the closing quote and the delimiter is ignored.
+		while (cursor < end && *cursor != ',' && *cursor != '\n')
+			cursor++;
+	}
+	else {
+		// Quotes inside an unquoted field are literal characters.
+		const char* start = cursor;
+		cursor = findStructural(cursor);
+		while (cursor < end && *cursor == '"')
+			cursor = findStructural(cursor + 1);
+		const char* fieldEnd = cursor;
+		if (fieldEnd > start && fieldEnd[-1] == '\r')
+			fieldEnd--;
+		field = std::string_view(start, fieldEnd - start);
+	}
+
+	if (cursor >= end || *cursor == '\n')
+		endOfRow = true;
+	if (cursor < end)
+		cursor++;
+	return true;
+}
+
+bool CSVReader::next(WineRecord& record)
+{
+	while (cursor < end) {
+		std::string_view fields[6];
+		bool endOfRow = false;
+		int count = 0;
+		while (count < 6 && readField(fields[count], endOfRow))
+			count++;
+		if (!endOfRow)
+			skipLine(); // Extra columns are ignored.
+		if (count < 6)
+			continue;
+
+		record.title = fields[0];
+		record.country = fields[1];
+		record.variety = fields[2];
+		record.province = fields[3];
+		record.price = parseInt(fields[4]);
+		record.points = parseInt(fields[5]);
+		return true;
+	}
+	return false;
+}
+
+std::vector<std::pair<const char*, const char*>> CSVReader::partition(const char* begin, const char* end, unsigned parts)
+{
+	std::vector<std::pair<const char*, const char*>> ranges;
+	if (parts == 0)
+		parts = 1;
+	size_t chunkSize = (end - begin) / parts + 1;
+
+	const char* start = begin;
+	while (start < end) {
+		const char* split = (size_t)(end - start) > chunkSize ? start + chunkSize : end;
+		if (split < end) {
+			const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+			split = newline == nullptr ? end : newline + 1;
+		}
+		ranges.emplace_back(start, split);
+		start = split;
+	}
+	return ranges;
+}
+
+int CSVReader::parseInt(std::string_view str)
+{
+	size_t i = 0;
+	while (i < str.size() && (str[i] == ' ' || str[i] == '\t'))
+		i++;
+	bool negative = false;
+	if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+		negative = str[i++] == '-';
+
+	int value = 0;
+	for (; i < str.size(); i++) {
+		unsigned digit = (unsigned)(str[i] - '0');
+		if (digit > 9)
+			break;
+		value = value * 10 + (int)digit;
+	}
+	return negative ? -value : value;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Arena.h"
+
+// One row of the wine CSV (title,country,variety,province,price,points).
+// String fields are views into the buffer being read, or into the arena when a quoted field had to be unescaped.
+struct WineRecord {
+	std::string_view title;
+	std::string_view country;
+	std::string_view variety;
+	std::string_view province;
+	int price;
+	int points;
+};
+
+// Tokenizes the wine CSV in place without copying unquoted fields.
+// Commas, quotes and newlines are located 64 bytes at a time using SSE2/AVX2 bitmasks where available.
+class CSVReader {
+private:
+	const char* cursor;
+	const char* end;
+
+	// Storage for quoted fields containing escaped ("") quotes.
+	Arena& arena;
+
+	// Bitmask of the structural characters (',', '"' and '\n') in the 64 bytes starting at blockStart.
+	const char* blockStart;
+	uint64_t blockMask;
+	bool vectorized;
+
+	// Fills blockMask for the block beginning at from.
+	void loadBlock(const char* from);
+
+	// Returns the first structural character at or after from, or end if there is none.
+	const char* findStructural(const char* from);
+
+	// Reads one field and advances cursor past its delimiter.
+	// Returns false if the row ended before the field was reached.
+	bool readField(std::string_view& field, bool& endOfRow);
+public:
+	// _vectorized = false forces the scalar scan (used for benchmarking).
+	CSVReader(const char* _begin, const char* _end, Arena& _arena, bool _vectorized = true);
+
+	// Skips the remainder of the current line (used for the header row).
+	void skipLine();
+
+	// Reads the next well-formed row into record. Malformed rows are skipped.
+	// Returns false once the input is exhausted.
+	bool next(WineRecord& record);
+
+	// Splits [begin, end) into at most parts ranges whose boundaries fall just after a newline,
+	// so every range holds whole rows. Quoted fields spanning lines may be split across ranges.
+	static std::vector<std::pair<const char*, const char*>> partition(const char* begin, const char* end, unsigned parts);
+
+	// Parses a base 10 integer, ignoring surrounding whitespace. Empty fields parse as 0.
+	static int parseInt(std::string_view str);
+};
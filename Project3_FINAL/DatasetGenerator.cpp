@@ -0,0 +1,266 @@
+#include "DatasetGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+	// Rows generated from one random stream. Part of the output format: changing it changes every file.
+	const uint64_t BLOCK_ROWS = 65536;
+
+	const char* const COUNTRIES[] = { "US", "France", "Italy", "Spain", "Portugal", "Chile", "Argentina", "Austria",
+		"Australia", "Germany", "New Zealand", "South Africa", "Israel", "Greece", "Canada", "Hungary", "Bulgaria",
+		"Romania", "Uruguay", "Turkey", "Slovenia", "Georgia", "England", "Croatia", "Mexico", "Moldova", "Brazil",
+		"Lebanon", "Morocco", "Peru", "Ukraine", "Serbia", "Czech Republic", "Macedonia", "Cyprus", "India",
+		"Switzerland", "Luxembourg", "Armenia", "Bosnia and Herzegovina", "Slovakia", "China", "Egypt" };
+
+	// Provinces of the first countries in COUNTRIES, most common first. Every other country gets a few numbered regions.
+	const vector<vector<const char*>> PROVINCES = {
+		{ "California", "Washington", "Oregon", "New York", "Virginia", "Idaho", "Michigan", "Texas", "Colorado",
+			"New Mexico", "Arizona", "Missouri", "North Carolina", "Pennsylvania", "Ohio" },
+		{ "Bordeaux", "Burgundy", "Alsace", "Loire Valley", "Champagne", "Southwest France", "Provence", "Rh\xc3\xb4ne Valley",
+			"Beaujolais", "Languedoc-Roussillon" },
+		{ "Tuscany", "Piedmont", "Veneto", "Northeastern Italy", "Sicily & Sardinia", "Southern Italy", "Central Italy",
+			"Lombardy", "Northwestern Italy", "Italy Other" },
+		{ "Northern Spain", "Catalonia", "Levante", "Central Spain", "Andalucia", "Spain Other", "Galicia" },
+		{ "Douro", "Alentejano", "Port", "Vinho Verde", "D\xc3\xa3o", "Bairrada", "Lisboa", "Tejo", "Pen\xc3\xadnsula de Set\xc3\xba" "bal" },
+		{ "Maipo Valley", "Colchagua Valley", "Casablanca Valley", "Central Valley", "Rapel Valley", "Maule Valley",
+			"Leyda Valley", "Aconcagua Valley" },
+		{ "Mendoza Province", "Other" },
+		{ "Burgenland", "Nieder\xc3\xb6sterreich", "Kamptal", "Kremstal", "Wachau", "S\xc3\xbc" "dsteiermark", "Carnuntum", "Wagram" },
+		{ "South Australia", "Victoria", "Western Australia", "New South Wales", "Tasmania", "Australia Other" },
+		{ "Mosel", "Rheingau", "Rheinhessen", "Pfalz", "Nahe", "Baden", "Franken" },
+		{ "Marlborough", "Central Otago", "Hawke's Bay", "Martinborough", "Nelson", "Gisborne" },
+		{ "Stellenbosch", "Western Cape", "Coastal Region", "Swartland", "Paarl", "Walker Bay", "Constantia" }
+	};
+	const int OTHER_REGIONS = 4;
+
+	// The most common varieties, most common first. The tail up to NUM_VARIETIES is numbered.
+	const char* const VARIETIES[] = { "Pinot Noir", "Chardonnay", "Cabernet Sauvignon", "Red Blend",
+		"Bordeaux-style Red Blend", "Riesling", "Sauvignon Blanc", "Syrah", "Ros\xc3\xa9", "Merlot", "Nebbiolo", "Zinfandel",
+		"Sangiovese", "Malbec", "Portuguese Red", "White Blend", "Sparkling Blend", "Tempranillo", "Rh\xc3\xb4ne-style Red Blend",
+		"Pinot Gris", "Champagne Blend", "Cabernet Franc", "Gr\xc3\xbcner Veltliner", "Portuguese White",
+		"Bordeaux-style White Blend", "Pinot Grigio", "Gamay", "Gew\xc3\xbcrztraminer", "Viognier", "Shiraz", "Petite Sirah",
+		"Sangiovese Grosso", "Barbera", "Glera", "Port", "Grenache", "Corvina, Rondinella, Molinara", "Chenin Blanc",
+		"Tempranillo Blend", "Carmen\xc3\xa8re", "Albari\xc3\xb1o", "Pinot Blanc", "Nero d'Avola", "Aglianico", "Moscato",
+		"Garnacha", "Petit Verdot", "Mourv\xc3\xa8" "dre", "Torront\xc3\xa9s", "Verdejo", "Montepulciano", "Tannat", "Cabernet Blend",
+		"Melon", "Touriga Nacional", "Dolcetto", "Primitivo", "S\xc3\xa9millon", "Vermentino", "Blaufr\xc3\xa4nkisch" };
+	const size_t NUM_VARIETIES = 700;
+
+	const char* const DESIGNATIONS[] = { "Reserve", "Estate", "Old Vine", "Single Vineyard", "Barrel Select", "Brut",
+		"Classico", "Riserva", "Gran Reserva", "Late Harvest", "Estate Grown", "Crianza", "Reserva", "Vintage",
+		"Unoaked", "Dry", "Extra Dry", "Grand Cru", "Premier Cru", "Cuv\xc3\xa9" "e Prestige", "Limited Release", "Block 7",
+		"Hillside", "Proprietor's Blend", "Sur Lie", "Blanc de Blancs", "Ros\xc3\xa9 of Pinot Noir", "Icon", "Signature", "Cellar Selection" };
+
+	const char* const SYLLABLES[] = { "ca", "la", "mor", "ven", "tri", "sol", "bel", "don", "ri", "sa", "ter", "vi",
+		"mon", "lu", "ber", "ga", "no", "ro", "tal", "fi", "par", "qui", "de", "sen", "al", "mar", "ti", "co", "vel", "nu",
+		"her", "ba", "ste", "pi", "or", "ze", "ha", "lin", "ke", "wal" };
+	const char* const WINERY_SUFFIXES[] = { "", "", "", " Estate", " Cellars", " Vineyards", " Winery", " Wines" };
+
+	// SplitMix64. Hand-rolled (like the transforms below) because the standard distributions may differ between
+	// standard libraries, and the output has to be the same everywhere.
+	class Random {
+	private:
+		uint64_t state;
+	public:
+		Random(uint64_t seed) : state(seed) { }
+
+		uint64_t next()
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+		// Uniform in [0, 1).
+		double uniform()
+		{
+			return (next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+		// Standard normal (Box-Muller, using one value of each pair).
+		double normal()
+		{
+			double radius = sqrt(-2.0 * log(1.0 - uniform()));
+			return radius * cos(6.283185307179586 * uniform());
+		}
+	};
+
+	// Draws ranks in [0, size) with probability falling as rank^-exponent. Inverts the continuous power law's CDF
+	// rather than searching a table, so a draw is O(1) and memory doesn't grow with size (the head is slightly flatter
+	// than an exact Zipf distribution).
+	class Zipf {
+	private:
+		double size, exponent;
+	public:
+		Zipf(size_t _size, double _exponent) : size((double)_size), exponent(_exponent) { }
+
+		size_t operator()(Random& random) const
+		{
+			double u = random.uniform();
+			double x = exponent == 1.0 ? exp(u * log(size + 1.0))
+				: pow(u * (pow(size + 1.0, 1.0 - exponent) - 1.0) + 1.0, 1.0 / (1.0 - exponent));
+			return (size_t)min(max(x - 1.0, 0.0), size - 1.0);
+		}
+	};
+
+	// Every name the rows are drawn from, shared read-only by the generating threads.
+	struct Vocabulary {
+		vector<string> varieties;
+		vector<vector<string>> provinces;
+		uint64_t numWineries;
+
+		Vocabulary(uint64_t rows)
+		{
+			for (size_t i = 0; i < NUM_VARIETIES; i++)
+				varieties.push_back(i < size(VARIETIES) ? VARIETIES[i] : "Variety " + to_string(i - size(VARIETIES) + 1));
+			for (size_t country = 0; country < size(COUNTRIES); country++) {
+				provinces.emplace_back();
+				if (country < PROVINCES.size())
+					provinces.back().assign(PROVINCES[country].begin(), PROVINCES[country].end());
+				else
+					for (int region = 1; region <= OTHER_REGIONS; region++)
+						provinces.back().push_back(string(COUNTRIES[country]) + " Region " + to_string(region));
+			}
+			// About eight wines per winery, as in the real data.
+			numWineries = max<uint64_t>(1000, rows / 8);
+		}
+	};
+
+	// A distinct name for every winery index, spelled out in SYLLABLES as digits.
+	void appendWinery(string& out, uint64_t winery)
+	{
+		size_t start = out.size();
+		uint64_t digits = winery / size(WINERY_SUFFIXES) + size(SYLLABLES);
+		while (digits > 0) {
+			out += SYLLABLES[digits % size(SYLLABLES)];
+			digits /= size(SYLLABLES);
+		}
+		out[start] = (char)toupper((unsigned char)out[start]);
+		out += WINERY_SUFFIXES[winery % size(WINERY_SUFFIXES)];
+	}
+
+	// Appends value as a CSV field, quoted if it holds a delimiter or quote.
+	void appendField(string& out, string_view value)
+	{
+		if (value.find_first_of(",\"\n") == string_view::npos) {
+			out.append(value.data(), value.size());
+			return;
+		}
+		out += '"';
+		for (char c : value) {
+			if (c == '"')
+				out += '"';
+			out += c;
+		}
+		out += '"';
+	}
+
+	// Generates the count rows of block into out.
+	void generateBlock(const Vocabulary& vocabulary, uint64_t seed, uint64_t block, uint64_t count, string& out)
+	{
+		const Zipf countries(size(COUNTRIES), 1.3);
+		const Zipf varieties(vocabulary.varieties.size(), 1.1);
+		const Zipf wineries(vocabulary.numWineries, 0.9);
+		Random random(Random(seed).next() ^ (block * 0xD1B54A32D192ED03ull));
+
+		out.clear();
+		string title;
+		for (uint64_t row = 0; row < count; row++) {
+			size_t country = countries(random);
+			const vector<string>& countryProvinces = vocabulary.provinces[country];
+			const string& province = countryProvinces[Zipf(countryProvinces.size(), 1.2)(random)];
+			const string& variety = vocabulary.varieties[varieties(random)];
+
+			// Winery, vintage (recent ones most common, 4% non-vintage), designation, variety and province.
+			title.clear();
+			appendWinery(title, wineries(random));
+			if (random.uniform() < 0.04)
+				title += " NV";
+			else
+				title += " " + to_string(2017 - min(27, (int)fabs(random.normal() * 5.0)));
+			if (random.uniform() < 0.45)
+				title += string(" ") + DESIGNATIONS[random.next() % size(DESIGNATIONS)];
+			title += " " + variety + " (" + province + ")";
+
+			// Log-normal price and a rating that rises with it.
+			double priceScore = random.normal();
+			int price = (int)lround(exp(log(28.0) + 0.7 * priceScore));
+			price = min(3300, max(4, price));
+			if (random.uniform() < 0.07)
+				price = 0;
+			int points = (int)lround(88.4 + 1.3 * priceScore + 2.6 * random.normal());
+			points = min(100, max(80, points));
+
+			appendField(out, title);
+			out += ',';
+			appendField(out, COUNTRIES[country]);
+			out += ',';
+			appendField(out, variety);
+			out += ',';
+			appendField(out, province);
+			out += ',' + to_string(price) + ',' + to_string(points) + '\n';
+		}
+	}
+}
+
+bool DatasetGenerator::writeCSV(const string& path, uint64_t rows, uint64_t seed, unsigned numThreads)
+{
+	ofstream file(path, ios::binary | ios::trunc);
+	if (!file)
+		return false;
+	file << "title,country,variety,province,price,points\n";
+
+	Vocabulary vocabulary(rows);
+	numThreads = max(1u, numThreads);
+	uint64_t numBlocks = (rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+	vector<string> buffers(numThreads);
+	// Each round generates one block per thread and writes them in block order.
+	for (uint64_t firstBlock = 0; firstBlock < numBlocks && file; firstBlock += numThreads) {
+		unsigned roundBlocks = (unsigned)min<uint64_t>(numThreads, numBlocks - firstBlock);
+		auto generate = [&](unsigned i) {
+			uint64_t block = firstBlock + i;
+			generateBlock(vocabulary, seed, block, min(BLOCK_ROWS, rows - block * BLOCK_ROWS), buffers[i]);
+		};
+		vector<thread> threads;
+		for (unsigned i = 1; i < roundBlocks; i++)
+			threads.emplace_back(generate, i);
+		generate(0);
+		for (thread& thread : threads)
+			thread.join();
+		for (unsigned i = 0; i < roundBlocks; i++)
+			file.write(buffers[i].data(), buffers[i].size());
+	}
+	file.flush();
+	return (bool)file;
+}
+
+bool DatasetGenerator::parseCount(const string& count, uint64_t& rows)
+{
+	size_t digits = 0;
+	while (digits < count.size() && isdigit((unsigned char)count[digits]))
+		digits++;
+	if (digits == 0 || digits > 12 || count.size() > digits + 1)
+		return false;
+	rows = stoull(count.substr(0, digits));
+	if (count.size() > digits) {
+		switch (toupper((unsigned char)count[digits])) {
+		case 'K':
+			rows *= 1000;
+			break;
+		case 'M':
+			rows *= 1000000;
+			break;
+		case 'G':
+			rows *= 1000000000;
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
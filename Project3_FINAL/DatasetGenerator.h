@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Writes synthetic wine CSV files in the format of winemag-data-130k-v2.csv (title,country,variety,province,price,points),
+// for scaling runs far beyond the real data set. Run with the --generate command line flag.
+//
+// Countries, provinces within each country and varieties follow Zipf's law, so a few values hold most wines
+// and a long tail holds a handful each. Titles combine a winery drawn from a pool that grows with the row count,
+// a vintage, an optional designation, the variety and the province, so most of them are unique. Prices are
+// log-normal (median about $28, 7% N/A written as 0) and ratings are normal around 88 points within 80 to 100,
+// rising with the price.
+//
+// For the same build on the same platform, the output depends only on the seed and the row count: rows are
+// generated in fixed-size blocks, each from its own random stream, so the thread count doesn't change a byte.
+// The distributions go through exp, log, pow and cos, whose last bits can differ between C runtimes, so
+// files generated on different platforms may differ.
+namespace DatasetGenerator {
+	// Writes rows wines to path on numThreads threads. Returns false if the file can't be written.
+	bool writeCSV(const std::string& path, uint64_t rows, uint64_t seed, unsigned numThreads = 1);
+
+	// Parses a row count such as 130000, 1M or 100M (K, M and G suffixes). Returns false if count isn't one.
+	bool parseCount(const std::string& count, uint64_t& rows);
+}
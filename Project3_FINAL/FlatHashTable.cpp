@@ -0,0 +1,172 @@
+#include "FlatHashTable.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASH_USE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. mask must not be zero.
+static inline unsigned lowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+FlatHashTable::FlatHashTable(WineStore& _store, Wine::Properties _hashBy, size_t expectedKeys) : numKeys(0), store(_store)
+{
+	switch (_hashBy) {
+	case Wine::Properties::VARIETY:
+		getHashedValue = &Wine::getVarietyView;
+		break;
+	case Wine::Properties::COUNTRY:
+		getHashedValue = &Wine::getCountryView;
+		break;
+	case Wine::Properties::PROVINCE:
+		getHashedValue = &Wine::getProvinceView;
+		break;
+	default:
+		getHashedValue = &Wine::getTitleView;
+	}
+
+	// Keeps the load factor under 7/8 without growing.
+	numGroups = 1;
+	while (numGroups * GROUP_WIDTH * 7 / 8 < expectedKeys)
+		numGroups *= 2;
+	control.assign(numGroups * GROUP_WIDTH, EMPTY);
+	slots.resize(numGroups * GROUP_WIDTH);
+}
+
+// 64-bit FNV-1a over the whole key, followed by a multiply-xorshift finalizer so that
+// both the low bits (control byte) and the high bits (group index) are well mixed.
+uint64_t FlatHashTable::hashFunction(std::string_view key)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : key) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+uint32_t FlatHashTable::matchGroup(size_t group, int8_t value) const
+{
+	const int8_t* bytes = &control[group * GROUP_WIDTH];
+#ifdef FLAT_HASH_USE_SSE2
+	__m128i groupBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(groupBytes, _mm_set1_epi8(value)));
+#else
+	uint32_t mask = 0;
+	for (size_t i = 0; i < GROUP_WIDTH; i++)
+		if (bytes[i] == value)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+size_t FlatHashTable::findSlot(std::string_view key, uint64_t hash, bool& found) const
+{
+	int8_t fragment = (int8_t)(hash & 0x7F);
+	size_t group = (size_t)(hash >> 7) & (numGroups - 1);
+
+	// Triangular probing over groups visits every group once when numGroups is a power of two.
+	for (size_t step = 1; ; step++) {
+		for (uint32_t matches = matchGroup(group, fragment); matches != 0; matches &= matches - 1) {
+			size_t slot = group * GROUP_WIDTH + lowestBit(matches);
+			if (slots[slot].key == key) {
+				found = true;
+				return slot;
+			}
+		}
+		uint32_t empties = matchGroup(group, EMPTY);
+		if (empties != 0) {
+			found = false;
+			return group * GROUP_WIDTH + lowestBit(empties);
+		}
+		group = (group + step) & (numGroups - 1);
+	}
+}
+
+void FlatHashTable::grow()
+{
+	vector<int8_t> oldControl;
+	vector<Slot> oldSlots;
+	oldControl.swap(control);
+	oldSlots.swap(slots);
+
+	numGroups *= 2;
+	control.assign(numGroups * GROUP_WIDTH, EMPTY);
+	slots.resize(numGroups * GROUP_WIDTH);
+	for (size_t i = 0; i < oldSlots.size(); i++) {
+		if (oldControl[i] == EMPTY)
+			continue;
+		uint64_t hash = hashFunction(oldSlots[i].key);
+		bool found;
+		size_t slot = findSlot(oldSlots[i].key, hash, found);
+		control[slot] = (int8_t)(hash & 0x7F);
+		slots[slot] = oldSlots[i];
+	}
+}
+
+void FlatHashTable::insert(Wine* data)
+{
+	std::string_view key = (data->*getHashedValue)();
+	uint64_t hash = hashFunction(key);
+	bool found;
+	size_t slot = findSlot(key, hash, found);
+	if (found) {
+		Slot& run = slots[slot];
+		if (run.count == run.capacity) {
+			uint32_t capacity = run.capacity * 2;
+			if (run.start + run.capacity != rows.size()) {
+				uint32_t start = (uint32_t)rows.size();
+				rows.resize(rows.size() + capacity);
+				std::copy(rows.begin() + run.start, rows.begin() + run.start + run.count, rows.begin() + start);
+				run.start = start;
+			}
+			else
+				rows.resize(rows.size() + run.capacity);
+			run.capacity = capacity;
+		}
+		rows[run.start + run.count++] = store.rowId(data);
+		return;
+	}
+
+	if ((numKeys + 1) * 8 > control.size() * 7) {
+		grow();
+		slot = findSlot(key, hash, found);
+	}
+	control[slot] = (int8_t)(hash & 0x7F);
+	slots[slot] = { key, (uint32_t)rows.size(), 1, 1 };
+	rows.push_back(store.rowId(data));
+	numKeys++;
+}
+
+void FlatHashTable::search(std::string_view searchKey, vector<Wine*>& results) const
+{
+	bool found;
+	size_t slot = findSlot(searchKey, hashFunction(searchKey), found);
+	if (found) {
+		const Slot& run = slots[slot];
+		results.reserve(results.size() + run.count);
+		for (uint32_t i = run.start + run.count; i > run.start; i--)
+			results.push_back(store[rows[i - 1]]);
+	}
+}
+
+size_t FlatHashTable::size() const
+{
+	return numKeys;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "Wine.h"
+#include "WineStore.h"
+
+// SwissTable style open addressing index with the same insert/search contract as HashTable: search() returns
+// the same wines in the same order (newest first).
+// Slots are probed 16 at a time by matching 7-bit hash fragments stored in a separate control byte array,
+// and every distinct key owns one contiguous run of the row ids of its matching wines, all kept in one shared array.
+// Since those are row ids, a table is tied to the store its wines come from. IndexManager offers it as
+// Structure::FLAT_HASH_TABLE (menu option 6, "flat" in batch mode); snapshots don't store it.
+class FlatHashTable {
+private:
+	static constexpr size_t GROUP_WIDTH = 16;
+	static constexpr int8_t EMPTY = -128;
+
+	struct Slot {
+		std::string_view key;
+		// The key's run is rows[start, start + count), with room for capacity row ids.
+		uint32_t start;
+		uint32_t count;
+		uint32_t capacity;
+	};
+
+	// One control byte per slot: EMPTY, or the low 7 bits of the key's hash.
+	vector<int8_t> control;
+	vector<Slot> slots;
+	// Row ids of every key's wines, in insertion order. A full run moves to the end with twice the room
+	// (or grows in place if it is the last one), so at most half of the array is left behind unused.
+	vector<WineStore::RowId> rows;
+
+	size_t numGroups; // Always a power of two.
+	size_t numKeys;
+
+	WineStore& store;
+	std::string_view(Wine::* getHashedValue)() const;
+
+	static uint64_t hashFunction(std::string_view key);
+
+	// Bitmask of the slots in group whose control byte equals value.
+	uint32_t matchGroup(size_t group, int8_t value) const;
+
+	// Returns the slot holding key, or the empty slot it should be inserted into.
+	// found tells which of the two it is.
+	size_t findSlot(std::string_view key, uint64_t hash, bool& found) const;
+
+	// Doubles the number of groups and reinserts every key.
+	void grow();
+public:
+	// Only wines returned by _store's operator[] can be inserted.
+	FlatHashTable(WineStore& _store, Wine::Properties _hashBy, size_t expectedKeys = 0);
+
+	void insert(Wine* data);
+	// Appends every wine whose key equals searchKey, newest first like HashTable. Allocates nothing beyond growing results.
+	void search(std::string_view searchKey, vector<Wine*>& results) const;
+
+	size_t size() const; // Number of distinct keys.
+};
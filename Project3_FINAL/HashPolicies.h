@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE4_2__) || defined(__AVX__)
+#include <nmmintrin.h>
+#define HASH_USE_SSE42_CRC
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Hash functions BasicHashTable can be instantiated with. Each one is a policy with a static
+// hash() over the whole key and a NAME for benchmark output.
+
+// djb2 over at most the first 30 bytes, as HashTable used to hash. Titles sharing a 30 byte prefix collide.
+struct TruncatedDjb2Hash {
+	static constexpr const char* NAME = "djb2 (30 bytes)";
+	static uint64_t hash(std::string_view key)
+	{
+		size_t length = key.size() > 30 ? 30 : key.size();
+		uint64_t hash = 5381;
+		hash = (hash << 5) + hash;
+		for (size_t i = 0; i < length && key[i] != 0; i++)
+			hash = ((hash << 5) + hash) + key[i];
+		return hash;
+	}
+};
+
+// djb2 over the whole key, one byte at a time.
+struct Djb2Hash {
+	static constexpr const char* NAME = "djb2";
+	static uint64_t hash(std::string_view key)
+	{
+		uint64_t hash = 5381;
+		for (char c : key)
+			hash = ((hash << 5) + hash) + (unsigned char)c;
+		return hash;
+	}
+};
+
+// 64-bit FNV-1a, one byte at a time.
+struct Fnv1aHash {
+	static constexpr const char* NAME = "FNV-1a";
+	static uint64_t hash(std::string_view key)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : key) {
+			hash ^= (unsigned char)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+
+// wyhash style: 16 bytes per step, each folded in with one 64x64->128 bit multiply.
+struct WyHash {
+	static constexpr const char* NAME = "wyhash";
+
+	// Multiplies a and b and folds the high half of the product into the low half.
+	static uint64_t mix(uint64_t a, uint64_t b)
+	{
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 product = (unsigned __int128)a * b;
+		return (uint64_t)product ^ (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		uint64_t high;
+		uint64_t low = _umul128(a, b, &high);
+		return low ^ high;
+#else
+		uint64_t aLow = (uint32_t)a, aHigh = a >> 32, bLow = (uint32_t)b, bHigh = b >> 32;
+		uint64_t lowLow = aLow * bLow, lowHigh = aLow * bHigh, highLow = aHigh * bLow, highHigh = aHigh * bHigh;
+		uint64_t middle = (lowLow >> 32) + (uint32_t)lowHigh + (uint32_t)highLow;
+		uint64_t low = (middle << 32) | (uint32_t)lowLow;
+		uint64_t high = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+		return low ^ high;
+#endif
+	}
+
+	static uint64_t read64(const char* data)
+	{
+		uint64_t word;
+		memcpy(&word, data, sizeof(word));
+		return word;
+	}
+
+	static uint64_t hash(std::string_view key)
+	{
+		const uint64_t P0 = 0xa0761d6478bd642full, P1 = 0xe7037ed1a0b428dbull, P2 = 0x8ebc6af09c88c6e3ull;
+		const char* data = key.data();
+		size_t length = key.size();
+		uint64_t hash = P0 ^ length;
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16)
+			hash = mix(read64(data + i) ^ P1, read64(data + i + 8) ^ hash);
+
+		// The last 0 to 15 bytes, zero padded.
+		uint64_t words[2] = { 0, 0 };
+		if (length > i)
+			memcpy(words, data + i, length - i);
+		hash = mix(words[0] ^ P1, words[1] ^ hash);
+		return mix(hash ^ P2, length ^ P1);
+	}
+};
+
+// CRC-32C, 8 bytes per instruction where SSE4.2 is available. The table driven fallback computes the same
+// values, so tables (and snapshots) built either way agree.
+struct Crc32Hash {
+	static constexpr const char* NAME = "CRC32";
+
+	static const std::array<uint32_t, 256>& table()
+	{
+		static const std::array<uint32_t, 256> crcTable = []() {
+			std::array<uint32_t, 256> entries = {};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+					crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+				entries[i] = crc;
+			}
+			return entries;
+		}();
+		return crcTable;
+	}
+
+	static uint64_t hash(std::string_view key)
+	{
+		const char* data = key.data();
+		size_t length = key.size();
+		uint32_t crc = 0xFFFFFFFFu;
+		size_t i = 0;
+#ifdef HASH_USE_SSE42_CRC
+		uint64_t wide = crc;
+		for (; i + 8 <= length; i += 8) {
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			wide = _mm_crc32_u64(wide, word);
+		}
+		crc = (uint32_t)wide;
+		for (; i < length; i++)
+			crc = _mm_crc32_u8(crc, (unsigned char)data[i]);
+#else
+		const std::array<uint32_t, 256>& crcTable = table();
+		for (; i < length; i++)
+			crc = crcTable[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+#endif
+		crc = ~crc;
+		// Spreads the 32-bit CRC over 64 bits so that the slot isn't taken from the CRC alone.
+		return (uint64_t)crc * 0x9E3779B97F4A7C15ull;
+	}
+};
@@ -1,118 +1,234 @@
 #include "HashTable.h"
+#include <algorithm>
 
-HashTable::HashTable(Wine::Properties _hashBy)
+HashTable::~HashTable() { }
+
+template <class KeyExtractor, class Hash>
+typename BasicHashTable<KeyExtractor, Hash>::HTNode BasicHashTable<KeyExtractor, Hash>::movedMarker(nullptr);
+template <class KeyExtractor, class Hash>
+typename BasicHashTable<KeyExtractor, Hash>::HTNode* const BasicHashTable<KeyExtractor, Hash>::MOVED = &BasicHashTable<KeyExtractor, Hash>::movedMarker;
+
+template <class KeyExtractor, class Hash>
+BasicHashTable<KeyExtractor, Hash>::BasicHashTable(KeyExtractor _key, size_t expectedKeys) : numKeys(0), oldTableSize(0), rehashIndex(0), key(_key)
 {
-	hashBy = _hashBy;
-
-	// Creates hashtable with appropriate table size.
-	switch (hashBy) {
-	case Wine::Properties::VARIETY:
-		getHashedValue = &Wine::getVariety;
-		tableSize = 1399;
-		break;
-	case Wine::Properties::COUNTRY:
-		getHashedValue = &Wine::getCountry;
-		tableSize = 89;
-		break;
-	case Wine::Properties::TITLE:
-		getHashedValue = &Wine::getTitle;
-		tableSize = 237619;
-		break;
-	case Wine::Properties::PROVINCE:
-		getHashedValue = &Wine::getProvince;
-		tableSize = 853;
-		break;
-	default:
-		getHashedValue = &Wine::getTitle;
-		tableSize = 237619;
-	}
+	// Sized so that expectedKeys keys stay under MAX_LOAD_FACTOR; it grows past that.
+	size_t neededSize = (size_t)(expectedKeys / MAX_LOAD_FACTOR) + 1;
+	tableSize = (int)std::min<size_t>(std::max<size_t>(neededSize, MIN_TABLE_SIZE), INT32_MAX) | 1;
 	hashTable.resize(tableSize, nullptr);
 }
 
-HashTable::HashTable(int _numData, Wine::Properties _hashBy)
+template <class KeyExtractor, class Hash>
+BasicHashTable<KeyExtractor, Hash>::BasicHashTable(int _numData, KeyExtractor _key) : numKeys(0), oldTableSize(0), rehashIndex(0), key(_key)
 {
-	tableSize = _numData * 2;
+	tableSize = _numData * 2 > 1 ? _numData * 2 : 1;
 	hashTable.resize(tableSize, nullptr);
-	hashBy = _hashBy;
-	switch (hashBy) {
-	case Wine::Properties::VARIETY:
-		getHashedValue = &Wine::getVariety;
-		break;
-	case Wine::Properties::COUNTRY:
-		getHashedValue = &Wine::getCountry;
-		break;
-	case Wine::Properties::TITLE:
-		getHashedValue = &Wine::getTitle;
-		break;
-	case Wine::Properties::PROVINCE:
-		getHashedValue = &Wine::getProvince;
-	default:
-		getHashedValue = &Wine::getTitle;
-	}
 }
 
-HashTable::~HashTable()
+template <class KeyExtractor, class Hash>
+BasicHashTable<KeyExtractor, Hash>::~BasicHashTable() { }
+
+template <class KeyExtractor, class Hash>
+int BasicHashTable<KeyExtractor, Hash>::hashFunction(std::string_view key, int size)
 {
-	for (HTNode* node : hashTable) {
-		if (node != nullptr) {
-			HTNode* chain = node->next;
-			while (chain != nullptr) {
-				HTNode* current = chain;
-				chain = chain->next;
-				delete current;
-			}
-			delete node;
-		}
+	return (int)(Hash::hash(key) % (uint64_t)size);
+}
+
+template <class KeyExtractor, class Hash>
+unsigned int BasicHashTable<KeyExtractor, Hash>::findSlot(const vector<HTNode*>& table, int size, std::string_view searchKey, unsigned int& probes)
+{
+	unsigned int index = hashFunction(searchKey, size);
+	probes = 0;
+	for (; table[index] != nullptr; index = (index + 1) % size, probes++) {
+		if (table[index] != MOVED && key(table[index]->data) == searchKey)
+			break;
 	}
+	return index;
 }
 
-// Uses the djb2 hash function algorithm.
-int HashTable::hashFunction(string key)
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::startRehash(int newSize)
 {
-	// Limits size of string to ensure constant time complexity 
-	if (key.size() > 30)
-		key.resize(30);
+	// Finishes any rehash already in progress first, so there are never more than two tables.
+	if (isRehashing())
+		rehashStep(oldTableSize);
+
+	oldTable.swap(hashTable);
+	oldTableSize = tableSize;
+	rehashIndex = 0;
+	// Odd sizes keep the modulo in hashFunction from discarding the low bits of the hash.
+	tableSize = newSize | 1;
+	hashTable.assign(tableSize, nullptr);
+}
 
-	char* str = &key[0];
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::moveOldSlot(unsigned int index)
+{
+	HTNode* chain = oldTable[index];
+	if (chain == nullptr || chain == MOVED)
+		return;
+	unsigned int probes;
+	unsigned int newIndex = findSlot(hashTable, tableSize, key(chain->data), probes);
+	hashTable[newIndex] = chain;
+	oldTable[index] = MOVED;
+}
 
-	unsigned long long hash = 5381;
-	int c;
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::rehashStep(int steps)
+{
+	for (; steps > 0 && rehashIndex < oldTableSize; steps--, rehashIndex++)
+		moveOldSlot(rehashIndex);
 
-	hash = ((hash << 5) + hash);
-	while (c = *str++) {
-		hash = ((hash << 5) + hash) + c;
+	if (rehashIndex >= oldTableSize) {
+		vector<HTNode*>().swap(oldTable);
+		oldTableSize = 0;
+		rehashIndex = 0;
 	}
-	return (hash % tableSize);
 }
 
-void HashTable::insert(Wine* data)
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::insert(Wine* data)
 {
 	// Converts key to index.
-	string valueToBeHashed = (data->*getHashedValue)();
-	unsigned int index = hashFunction(valueToBeHashed);
+	std::string_view valueToBeHashed = key(data);
+	unsigned int probes;
+
+	// Keys still in the old table are moved over first so that every duplicate chains together.
+	if (isRehashing()) {
+		unsigned int oldIndex = findSlot(oldTable, oldTableSize, valueToBeHashed, probes);
+		if (oldTable[oldIndex] != nullptr)
+			moveOldSlot(oldIndex);
+		rehashStep(REHASH_STEPS);
+	}
 
 	// Finds open address for newNode.
-	for (; hashTable[index] != nullptr; index = (index + 1) % tableSize) {
-		if ((hashTable[index]->data->*getHashedValue)() == valueToBeHashed)
-			break;
+	unsigned int index = findSlot(hashTable, tableSize, valueToBeHashed, probes);
+	if (hashTable[index] == nullptr) {
+		if (numKeys + 1 > tableSize * MAX_LOAD_FACTOR) {
+			startRehash(tableSize * 2);
+			rehashStep(REHASH_STEPS);
+			index = findSlot(hashTable, tableSize, valueToBeHashed, probes);
+		}
+		numKeys++;
 	}
-	HTNode* newNode = new HTNode(data, hashTable[index]);
+	INDEX_STAT(insertProbes.add(probes));
+	HTNode* newNode = nodeArena.create<HTNode>(data, hashTable[index]);
 	hashTable[index] = newNode;
 }
 
-void HashTable::search(string searchKey, vector<Wine*>& results)
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::search(std::string_view searchKey, vector<Wine*>& results)
 {
 	// Converts into the appropriate index it'll be located at.
-	unsigned int index = hashFunction(searchKey);
-
-	for (; hashTable[index] != nullptr; index = (index + 1) % tableSize) {
-		if ((hashTable[index]->data->*getHashedValue)() == searchKey) {
-			HTNode* temp = hashTable[index];
+	unsigned int probes, totalProbes = 0;
+	for (vector<HTNode*>* table : { &hashTable, &oldTable }) {
+		if (table->empty())
+			continue;
+		unsigned int index = findSlot(*table, (int)table->size(), searchKey, probes);
+		totalProbes += probes;
+		HTNode* temp = (*table)[index];
+		if (temp != nullptr) {
 			while (temp != nullptr) {
 				results.push_back(temp->data);
 				temp = temp->next;
 			}
-			return;
+			break;
 		}
 	}
-}
\ No newline at end of file
+	INDEX_STAT(searchProbes.add(totalProbes));
+}
+
+template <class KeyExtractor, class Hash>
+void BasicHashTable<KeyExtractor, Hash>::reserve(size_t distinctKeys)
+{
+	int neededSize = (int)(distinctKeys / MAX_LOAD_FACTOR) + 1;
+	if (neededSize > tableSize) {
+		startRehash(neededSize);
+		// Nothing has to stay responsive while reserving, so the move is done all at once.
+		rehashStep(oldTableSize);
+	}
+}
+
+template <class KeyExtractor, class Hash>
+int BasicHashTable<KeyExtractor, Hash>::size() const
+{
+	return numKeys;
+}
+
+template <class KeyExtractor, class Hash>
+int BasicHashTable<KeyExtractor, Hash>::capacity() const
+{
+	return tableSize;
+}
+
+template <class KeyExtractor, class Hash>
+bool BasicHashTable<KeyExtractor, Hash>::isRehashing() const
+{
+	return !oldTable.empty();
+}
+
+template <class KeyExtractor, class Hash>
+double BasicHashTable<KeyExtractor, Hash>::averageProbeLength() const
+{
+	if (numKeys == 0)
+		return 0;
+	// Keys still in the old table are counted where they'd be found there.
+	double total = 0;
+	for (const vector<HTNode*>* table : { &hashTable, &oldTable }) {
+		unsigned int size = (unsigned int)table->size();
+		for (unsigned int index = 0; index < size; index++) {
+			HTNode* node = (*table)[index];
+			if (node == nullptr || node == MOVED)
+				continue;
+			unsigned int home = hashFunction(key(node->data), size);
+			total += (index + size - home) % size;
+		}
+	}
+	return total / numKeys;
+}
+
+template <class KeyExtractor, class Hash>
+HashTableStats BasicHashTable<KeyExtractor, Hash>::getStats() const
+{
+	HashTableStats stats;
+	stats.keys = numKeys;
+	stats.capacity = tableSize;
+	stats.loadFactor = (double)numKeys / tableSize;
+	stats.rehashing = isRehashing();
+	for (const vector<HTNode*>* table : { &hashTable, &oldTable }) {
+		for (HTNode* node : *table) {
+			if (node == nullptr || node == MOVED)
+				continue;
+			uint64_t length = 0;
+			for (; node != nullptr; node = node->next)
+				length++;
+			stats.chainLengths.add(length);
+		}
+	}
+#ifdef INDEX_STATS
+	stats.insertProbes = insertProbes.snapshot();
+	stats.searchProbes = searchProbes.snapshot();
+#endif
+	return stats;
+}
+
+template class BasicHashTable<VarietyKey, TruncatedDjb2Hash>;
+template class BasicHashTable<CountryKey, TruncatedDjb2Hash>;
+template class BasicHashTable<TitleKey, TruncatedDjb2Hash>;
+template class BasicHashTable<ProvinceKey, TruncatedDjb2Hash>;
+template class BasicHashTable<VarietyKey, Djb2Hash>;
+template class BasicHashTable<CountryKey, Djb2Hash>;
+template class BasicHashTable<TitleKey, Djb2Hash>;
+template class BasicHashTable<ProvinceKey, Djb2Hash>;
+template class BasicHashTable<VarietyKey, Fnv1aHash>;
+template class BasicHashTable<CountryKey, Fnv1aHash>;
+template class BasicHashTable<TitleKey, Fnv1aHash>;
+template class BasicHashTable<ProvinceKey, Fnv1aHash>;
+template class BasicHashTable<VarietyKey, WyHash>;
+template class BasicHashTable<CountryKey, WyHash>;
+template class BasicHashTable<TitleKey, WyHash>;
+template class BasicHashTable<ProvinceKey, WyHash>;
+template class BasicHashTable<VarietyKey, Crc32Hash>;
+template class BasicHashTable<CountryKey, Crc32Hash>;
+template class BasicHashTable<TitleKey, Crc32Hash>;
+template class BasicHashTable<ProvinceKey, Crc32Hash>;
+template class BasicHashTable<RuntimeKey, WyHash>;
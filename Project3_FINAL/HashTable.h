@@ -1,6 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
 #include "Wine.h"
+#include "Arena.h"
+#include "HashPolicies.h"
+#include "IndexKeys.h"
+#include "IndexStats.h"
 
+// Hash index over one string property: linear probing over slots that each hold the chain of wines sharing a key.
+// This is the interface the rest of the program uses; BasicHashTable below implements it for one key extractor
+// and hash function, so that both inline into the probing loop. create() picks the one for a property.
 class HashTable {
+public:
+	virtual ~HashTable();
+
+	// Returns an empty table over property (TITLE for properties that aren't strings) hashed by Hash,
+	// sized for expectedKeys distinct keys.
+	template <class Hash = WyHash>
+	static std::unique_ptr<HashTable> create(Wine::Properties property, size_t expectedKeys = 0);
+
+	// Adds a new wine object based on pointer. 
+	// Obtained through the temp vector of wine pointers.
+	virtual void insert(Wine* data) = 0;
+
+	// Takes in inputted search value and returns all wine objects that match with the key.
+	// Prints data of all objects within function.
+	// Used for search values.
+	// Allocates nothing beyond growing results.
+	virtual void search(std::string_view searchKey, vector<Wine*>& results) = 0;
+
+	// Grows the table up front so that distinctKeys keys fit without rehashing (e.g. from WineStore::estimateDistinct).
+	virtual void reserve(size_t distinctKeys) = 0;
+
+	virtual int size() const = 0; // Number of distinct keys.
+	virtual int capacity() const = 0; // Number of slots in the current table.
+	virtual bool isRehashing() const = 0;
+	// Mean number of slots a successful search probes past a key's home slot (0 when every key sits in its own).
+	virtual double averageProbeLength() const = 0;
+	// Load factor and chain lengths, plus the probe lengths counted so far when built with INDEX_STATS.
+	virtual HashTableStats getStats() const = 0;
+};
+
+// Table whose keys are read by KeyExtractor (see IndexKeys.h) and hashed by Hash (see HashPolicies.h). wyhash hashes
+// whole titles faster than truncated djb2 hashed their first 30 bytes, with a quarter of the probes on titles sharing
+// long prefixes (see Benchmark::hashPolicies). Defined in HashTable.cpp for PropertyKey of every string property with
+// every hash policy, and for RuntimeKey with WyHash.
+template <class KeyExtractor, class Hash = WyHash>
+class BasicHashTable : public HashTable {
 private:
 	// Struct for node in table (data and pointer for dupes):
 	struct HTNode {
@@ -9,6 +55,18 @@ private:
 		HTNode(Wine* _data, HTNode* _next = nullptr) : data(_data), next(_next) { }
 	};
 
+	// Marks a slot of the old table whose chain was already moved to the new table.
+	// Probing treats it as occupied so that chains past it stay reachable.
+	static HTNode movedMarker;
+	static HTNode* const MOVED;
+
+	// Once more than this fraction of the slots hold a key, the table starts doubling.
+	static constexpr double MAX_LOAD_FACTOR = 0.5;
+	// Old slots moved into the new table per insert while a rehash is in progress.
+	static constexpr int REHASH_STEPS = 4;
+	// Smallest table a constructor makes.
+	static constexpr size_t MIN_TABLE_SIZE = 17;
+
 	// The amount of data entries from the data set.
 	// Default hash table size = val * 2.
 	int tableSize;
@@ -16,29 +74,69 @@ private:
 	// Data structure that stores the hashes.
 	vector<HTNode*> hashTable;
 
-	// Wine property being processed (key type).
-	Wine::Properties hashBy;
+	// Every HTNode is bump allocated here and released together with the table.
+	Arena nodeArena;
+
+	// Number of distinct keys stored (occupied slots).
+	int numKeys;
+
+	// Previous table while an incremental rehash is in progress (empty otherwise).
+	// Slots before rehashIndex have already been moved into hashTable.
+	vector<HTNode*> oldTable;
+	int oldTableSize;
+	int rehashIndex;
+
+	// Reads the key of a wine.
+	KeyExtractor key;
+
+	// Calculates the hashcode for a key with Hash.
+	// Returns the index it is located at in a table of size size.
+	static int hashFunction(std::string_view key, int size);
 
-	// Calculates the hashcode for a key.
-	// Returns the index it is located at in the hash table.
-	int hashFunction(string key);
+	// Returns the slot in table holding searchKey, or the empty slot where it would go.
+	// probes is set to the number of slots looked at past searchKey's home slot.
+	unsigned int findSlot(const vector<HTNode*>& table, int size, std::string_view searchKey, unsigned int& probes);
 
-	// Eq. of switch to get data's key value based on hashBy.
-	string(Wine::* getHashedValue)() const;
+#ifdef INDEX_STATS
+	AtomicDistribution insertProbes;
+	AtomicDistribution searchProbes;
+#endif
+
+	// Starts moving every key into a table of at least newSize slots.
+	void startRehash(int newSize);
+	// Moves up to steps old slots into the new table.
+	void rehashStep(int steps);
+	// Moves the chain in old slot index into the new table.
+	void moveOldSlot(unsigned int index);
 public:
-	// Constructor for size based on hashBy type.
-	HashTable(Wine::Properties _hashBy);
+	// Constructor for a table sized for expectedKeys distinct keys (e.g. from WineStore::estimateDistinct).
+	BasicHashTable(KeyExtractor _key = KeyExtractor(), size_t expectedKeys = 0);
 	// Default constructor.
-	HashTable(int _numData, Wine::Properties _hashBy);
+	BasicHashTable(int _numData, KeyExtractor _key = KeyExtractor());
 	// Destructor.
-	~HashTable();
+	~BasicHashTable();
 
-	// Adds a new wine object based on pointer. 
-	// Obtained through the temp vector of wine pointers.
-	void insert(Wine* data);
+	void insert(Wine* data) override;
+	void search(std::string_view searchKey, vector<Wine*>& results) override;
+	void reserve(size_t distinctKeys) override;
+	int size() const override;
+	int capacity() const override;
+	bool isRehashing() const override;
+	double averageProbeLength() const override;
+	HashTableStats getStats() const override;
+};
 
-	// Takes in inputted search value and returns all wine objects that match with the key.
-	// Prints data of all objects within function.
-	// Used for search values.
-	void search(string strKey, vector<Wine*>& results);
-};
\ No newline at end of file
+template <class Hash>
+std::unique_ptr<HashTable> HashTable::create(Wine::Properties property, size_t expectedKeys)
+{
+	switch (property) {
+	case Wine::Properties::VARIETY:
+		return std::unique_ptr<HashTable>(new BasicHashTable<VarietyKey, Hash>(VarietyKey(), expectedKeys));
+	case Wine::Properties::COUNTRY:
+		return std::unique_ptr<HashTable>(new BasicHashTable<CountryKey, Hash>(CountryKey(), expectedKeys));
+	case Wine::Properties::PROVINCE:
+		return std::unique_ptr<HashTable>(new BasicHashTable<ProvinceKey, Hash>(ProvinceKey(), expectedKeys));
+	default:
+		return std::unique_ptr<HashTable>(new BasicHashTable<TitleKey, Hash>(TitleKey(), expectedKeys));
+	}
+}
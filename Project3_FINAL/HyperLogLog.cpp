@@ -0,0 +1,54 @@
+#include "HyperLogLog.h"
+#include <cmath>
+
+HyperLogLog::HyperLogLog(int _precision) : precision(_precision), registers((size_t)1 << _precision, 0) { }
+
+// 64-bit FNV-1a followed by a multiply-xorshift finalizer, since the estimate relies on well mixed high bits.
+uint64_t HyperLogLog::hashFunction(std::string_view value)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : value) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+void HyperLogLog::add(std::string_view value)
+{
+	uint64_t hash = hashFunction(value);
+	size_t index = (size_t)(hash >> (64 - precision));
+	// Rank of the first set bit in the remaining bits (1 based).
+	uint64_t remaining = (hash << precision) | ((uint64_t)1 << (precision - 1));
+	uint8_t rank = 1;
+	while ((remaining & ((uint64_t)1 << 63)) == 0) {
+		remaining <<= 1;
+		rank++;
+	}
+	if (rank > registers[index])
+		registers[index] = rank;
+}
+
+size_t HyperLogLog::estimate() const
+{
+	double m = (double)registers.size();
+	double sum = 0;
+	size_t zeros = 0;
+	for (uint8_t value : registers) {
+		sum += std::ldexp(1.0, -value);
+		if (value == 0)
+			zeros++;
+	}
+	double alpha = 0.7213 / (1.0 + 1.079 / m);
+	double estimate = alpha * m * m / sum;
+
+	// Linear counting is more accurate while many registers are still empty.
+	if (estimate <= 2.5 * m && zeros > 0)
+		estimate = m * std::log(m / zeros);
+	return (size_t)(estimate + 0.5);
+}
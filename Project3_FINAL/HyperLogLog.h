@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Estimates the number of distinct strings added using 2^precision one byte registers
+// (standard error about 1.04 / sqrt(2^precision)).
+class HyperLogLog {
+private:
+	int precision;
+	std::vector<uint8_t> registers;
+
+	static uint64_t hashFunction(std::string_view value);
+public:
+	HyperLogLog(int _precision = 12);
+
+	void add(std::string_view value);
+	size_t estimate() const;
+};
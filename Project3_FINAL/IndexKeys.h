@@ -0,0 +1,61 @@
+#pragma once
+#include <string_view>
+#include "Wine.h"
+
+// Key extractors and comparisons that BasicRedBlackTree and BasicHashTable are instantiated with.
+// An extractor returns a view of the key a wine is indexed by and names the property it reads.
+
+// Selects the key at compile time, so that reading it inlines to a field load.
+template <Wine::Properties PROPERTY>
+struct PropertyKey {
+	Wine::Properties property() const { return PROPERTY; }
+
+	std::string_view operator()(const Wine* wine) const
+	{
+		if constexpr (PROPERTY == Wine::Properties::VARIETY)
+			return wine->getVarietyView();
+		else if constexpr (PROPERTY == Wine::Properties::COUNTRY)
+			return wine->getCountryView();
+		else if constexpr (PROPERTY == Wine::Properties::PROVINCE)
+			return wine->getProvinceView();
+		else
+			return wine->getTitleView();
+	}
+};
+
+typedef PropertyKey<Wine::Properties::VARIETY> VarietyKey;
+typedef PropertyKey<Wine::Properties::COUNTRY> CountryKey;
+typedef PropertyKey<Wine::Properties::TITLE> TitleKey;
+typedef PropertyKey<Wine::Properties::PROVINCE> ProvinceKey;
+
+// Selects the key at run time through a member function pointer, the way the indexes did before they were
+// templates. Kept as the baseline for Benchmark::specializedIndexes.
+struct RuntimeKey {
+	Wine::Properties keyProperty;
+	std::string_view(Wine::* getKey)() const;
+
+	RuntimeKey(Wine::Properties _property = Wine::Properties::TITLE) : keyProperty(_property)
+	{
+		switch (keyProperty) {
+		case Wine::Properties::VARIETY:
+			getKey = &Wine::getVarietyView;
+			break;
+		case Wine::Properties::COUNTRY:
+			getKey = &Wine::getCountryView;
+			break;
+		case Wine::Properties::PROVINCE:
+			getKey = &Wine::getProvinceView;
+			break;
+		default:
+			getKey = &Wine::getTitleView;
+		}
+	}
+
+	Wine::Properties property() const { return keyProperty; }
+	std::string_view operator()(const Wine* wine) const { return (wine->*getKey)(); }
+};
+
+// Byte-wise three-way comparison (negative, zero or positive), the order every tree keeps its keys in.
+struct KeyCompare {
+	int operator()(std::string_view k1, std::string_view k2) const { return k1.compare(k2); }
+};
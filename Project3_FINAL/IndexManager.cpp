@@ -0,0 +1,395 @@
+#include "IndexManager.h"
+#include <algorithm>
+#include <chrono>
+
+IndexManager::IndexManager(WineStore& _store) : store(_store), preOrderedRows(false)
+{
+	for (int property = 0; property < NUM_PROPERTIES; property++) {
+		for (int structure = 0; structure < NUM_STRUCTURES; structure++) {
+			states[structure][property] = State::NOT_BUILT;
+			constructionTimes[structure][property] = 0.0;
+			buildProgress[structure][property] = 0.0f;
+		}
+	}
+}
+
+IndexManager::~IndexManager()
+{
+	stopWarmUp();
+}
+
+void IndexManager::buildTree(Wine::Properties property, unsigned numThreads, const Progress& progress)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_ptr<RedBlackTree> tree = RedBlackTree::create(property);
+	tree->bulkLoad(store.getWines(), numThreads, progress);
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(stateMutex);
+	trees[(int)property] = std::move(tree);
+	constructionTimes[(int)Structure::RED_BLACK_TREE][(int)property] = std::chrono::duration<double>(stop - start).count();
+}
+
+void IndexManager::buildHashTable(Wine::Properties property, const Progress& progress)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	// Sized for the column's distinct keys so the bulk insert doesn't rehash.
+	std::unique_ptr<HashTable> table = HashTable::create(property, store.estimateDistinct(property));
+	size_t step = std::max<size_t>(1, store.size() / 100);
+	for (WineStore::RowId id = 0; id < store.size(); id++) {
+		table->insert(store[id]);
+		if (progress && (id + 1) % step == 0 && id + 1 < store.size())
+			progress((float)(id + 1) / store.size());
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(stateMutex);
+	hashTables[(int)property] = std::move(table);
+	constructionTimes[(int)Structure::HASH_TABLE][(int)property] = std::chrono::duration<double>(stop - start).count();
+}
+
+void IndexManager::buildBPlusTree(Wine::Properties property, const Progress& progress)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_ptr<BPlusTree> tree(new BPlusTree(property));
+	size_t step = std::max<size_t>(1, store.size() / 100);
+	for (WineStore::RowId id = 0; id < store.size(); id++) {
+		tree->insert(store[id]);
+		if (progress && (id + 1) % step == 0 && id + 1 < store.size())
+			progress((float)(id + 1) / store.size());
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(stateMutex);
+	bPlusTrees[(int)property] = std::move(tree);
+	constructionTimes[(int)Structure::B_PLUS_TREE][(int)property] = std::chrono::duration<double>(stop - start).count();
+}
+
+void IndexManager::buildFlatHashTable(Wine::Properties property, const Progress& progress)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::unique_ptr<FlatHashTable> table(new FlatHashTable(store, property, store.estimateDistinct(property)));
+	size_t step = std::max<size_t>(1, store.size() / 100);
+	for (WineStore::RowId id = 0; id < store.size(); id++) {
+		table->insert(store[id]);
+		if (progress && (id + 1) % step == 0 && id + 1 < store.size())
+			progress((float)(id + 1) / store.size());
+	}
+	auto stop = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(stateMutex);
+	flatHashTables[(int)property] = std::move(table);
+	constructionTimes[(int)Structure::FLAT_HASH_TABLE][(int)property] = std::chrono::duration<double>(stop - start).count();
+}
+
+void IndexManager::ensureBuilt(Structure structure, Wine::Properties property, unsigned numThreads, const Progress& progress)
+{
+	int s = (int)structure, p = (int)property;
+	std::unique_lock<std::mutex> lock(stateMutex);
+	while (states[s][p] == State::BUILDING) {
+		// Another thread (usually the warm-up) owns this build.
+		if (progress) {
+			stateChanged.wait_for(lock, std::chrono::milliseconds(50));
+			lock.unlock();
+			progress(std::min(getWarmUpProgress(), 0.99f));
+			lock.lock();
+		}
+		else {
+			stateChanged.wait(lock);
+		}
+	}
+	if (states[s][p] == State::BUILT) {
+		lock.unlock();
+		if (progress)
+			progress(1.0f);
+		return;
+	}
+	states[s][p] = State::BUILDING;
+	buildProgress[s][p] = 0.0f;
+	lock.unlock();
+
+	Progress track = [&](float fraction) {
+		buildProgress[s][p] = fraction;
+		if (progress)
+			progress(fraction);
+	};
+	switch (structure) {
+	case Structure::RED_BLACK_TREE:
+		buildTree(property, numThreads, track);
+		break;
+	case Structure::HASH_TABLE:
+		buildHashTable(property, track);
+		break;
+	case Structure::B_PLUS_TREE:
+		buildBPlusTree(property, track);
+		break;
+	case Structure::FLAT_HASH_TABLE:
+		buildFlatHashTable(property, track);
+		break;
+	}
+	buildProgress[s][p] = 1.0f;
+
+	lock.lock();
+	states[s][p] = State::BUILT;
+	stateChanged.notify_all();
+	lock.unlock();
+	if (progress)
+		progress(1.0f);
+}
+
+RedBlackTree& IndexManager::getTree(Wine::Properties property, const Progress& progress)
+{
+	ensureBuilt(Structure::RED_BLACK_TREE, property, std::max(1u, std::thread::hardware_concurrency()), progress);
+	return *trees[(int)property];
+}
+
+HashTable& IndexManager::getHashTable(Wine::Properties property, const Progress& progress)
+{
+	ensureBuilt(Structure::HASH_TABLE, property, 1, progress);
+	return *hashTables[(int)property];
+}
+
+BPlusTree& IndexManager::getBPlusTree(Wine::Properties property, const Progress& progress)
+{
+	ensureBuilt(Structure::B_PLUS_TREE, property, 1, progress);
+	return *bPlusTrees[(int)property];
+}
+
+FlatHashTable& IndexManager::getFlatHashTable(Wine::Properties property, const Progress& progress)
+{
+	ensureBuilt(Structure::FLAT_HASH_TABLE, property, 1, progress);
+	return *flatHashTables[(int)property];
+}
+
+const RatingIndex& IndexManager::getRatingIndex()
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	if (!ratingIndex)
+		ratingIndex.reset(new RatingIndex(store));
+	return *ratingIndex;
+}
+
+const PriceIndex& IndexManager::getPriceIndex()
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	if (!priceIndex)
+		priceIndex.reset(new PriceIndex(store));
+	return *priceIndex;
+}
+
+const PostingIndex& IndexManager::getPostingIndex(Wine::Properties property)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	if (!postingIndexes[(int)property])
+		postingIndexes[(int)property].reset(new PostingIndex(store, property, preOrderedRows));
+	return *postingIndexes[(int)property];
+}
+
+void IndexManager::setPreOrderedRows(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	preOrderedRows = enabled;
+}
+
+bool IndexManager::topRows(Wine::Properties property, std::string_view key, Wine::Properties orderBy, size_t count, vector<Wine*>& results)
+{
+	if (!preOrderedRows || store.getDictionary(property) == nullptr)
+		return false;
+	vector<WineStore::RowId> rows;
+	if (!getPostingIndex(property).top(key, orderBy, count, rows))
+		return false;
+	for (WineStore::RowId id : rows)
+		results.push_back(store[id]);
+	return true;
+}
+
+void IndexManager::build(Structure structure, Wine::Properties property, const Progress& progress)
+{
+	switch (structure) {
+	case Structure::RED_BLACK_TREE:
+		getTree(property, progress);
+		break;
+	case Structure::HASH_TABLE:
+		getHashTable(property, progress);
+		break;
+	case Structure::B_PLUS_TREE:
+		getBPlusTree(property, progress);
+		break;
+	case Structure::FLAT_HASH_TABLE:
+		getFlatHashTable(property, progress);
+		break;
+	}
+}
+
+void IndexManager::search(Structure structure, Wine::Properties property, std::string_view key, vector<Wine*>& results)
+{
+	switch (structure) {
+	case Structure::RED_BLACK_TREE:
+		getTree(property).search(key, results);
+		break;
+	case Structure::HASH_TABLE:
+		getHashTable(property).search(key, results);
+		break;
+	case Structure::B_PLUS_TREE:
+		getBPlusTree(property).search(key, results);
+		break;
+	case Structure::FLAT_HASH_TABLE:
+		getFlatHashTable(property).search(key, results);
+		break;
+	}
+}
+
+bool IndexManager::searchRange(Structure structure, Wine::Properties property, std::string_view low, std::string_view high, vector<Wine*>& results)
+{
+	switch (structure) {
+	case Structure::RED_BLACK_TREE:
+		getTree(property).searchRange(low, high, results);
+		return true;
+	case Structure::B_PLUS_TREE:
+		getBPlusTree(property).searchRange(low, high, results);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IndexManager::searchPrefix(Structure structure, Wine::Properties property, std::string_view prefix, vector<Wine*>& results)
+{
+	switch (structure) {
+	case Structure::RED_BLACK_TREE:
+		getTree(property).searchPrefix(prefix, results);
+		return true;
+	case Structure::B_PLUS_TREE:
+		getBPlusTree(property).searchPrefix(prefix, results);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IndexManager::isOrdered(Structure structure)
+{
+	return structure == Structure::RED_BLACK_TREE || structure == Structure::B_PLUS_TREE;
+}
+
+void IndexManager::setPostingIndex(Wine::Properties property, std::unique_ptr<PostingIndex> index)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	if (index && index->isPreOrdered() != preOrderedRows)
+		index.reset();
+	postingIndexes[(int)property] = std::move(index);
+}
+
+void IndexManager::setRatingIndex(std::unique_ptr<RatingIndex> index)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	ratingIndex = std::move(index);
+}
+
+void IndexManager::setPriceIndex(std::unique_ptr<PriceIndex> index)
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	priceIndex = std::move(index);
+}
+
+void IndexManager::warmUp(unsigned numThreads)
+{
+	stopWarmUp();
+	warmUpIndexes.clear();
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		for (Wine::Properties property : { Wine::Properties::VARIETY, Wine::Properties::COUNTRY, Wine::Properties::TITLE, Wine::Properties::PROVINCE }) {
+			for (Structure structure : { Structure::RED_BLACK_TREE, Structure::HASH_TABLE }) {
+				warmUpIndexes.emplace_back(structure, property);
+				if (states[(int)structure][(int)property] == State::NOT_BUILT)
+					warmUpJobs.emplace_back(structure, property);
+			}
+		}
+	}
+	numThreads = std::max(1u, std::min(numThreads, (unsigned)warmUpJobs.size()));
+	for (unsigned i = 0; i < numThreads; i++)
+		warmUpThreads.emplace_back(&IndexManager::runWarmUpJobs, this);
+}
+
+void IndexManager::runWarmUpJobs()
+{
+	while (true) {
+		std::pair<Structure, Wine::Properties> job;
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			if (warmUpJobs.empty())
+				return;
+			job = warmUpJobs.front();
+			warmUpJobs.pop_front();
+		}
+		// The pool already provides the parallelism, so each tree sorts on its own thread.
+		ensureBuilt(job.first, job.second, 1, nullptr);
+	}
+}
+
+void IndexManager::stopWarmUp()
+{
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		warmUpJobs.clear();
+	}
+	for (std::thread& worker : warmUpThreads)
+		worker.join();
+	warmUpThreads.clear();
+}
+
+float IndexManager::getWarmUpProgress() const
+{
+	if (warmUpIndexes.empty())
+		return 1.0f;
+	float total = 0.0f;
+	for (const std::pair<Structure, Wine::Properties>& index : warmUpIndexes)
+		total += buildProgress[(int)index.first][(int)index.second];
+	return total / warmUpIndexes.size();
+}
+
+bool IndexManager::isBuilt(Structure structure, Wine::Properties property) const
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	return states[(int)structure][(int)property] == State::BUILT;
+}
+
+bool IndexManager::isBuilding(Structure structure, Wine::Properties property) const
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	return states[(int)structure][(int)property] == State::BUILDING;
+}
+
+double IndexManager::getConstructionTime(Structure structure, Wine::Properties property) const
+{
+	std::lock_guard<std::mutex> lock(stateMutex);
+	return states[(int)structure][(int)property] == State::BUILT ? constructionTimes[(int)structure][(int)property] : 0.0;
+}
+
+void IndexManager::invalidate()
+{
+	stopWarmUp();
+	warmUpIndexes.clear();
+	for (int property = 0; property < NUM_PROPERTIES; property++)
+		invalidate((Wine::Properties)property);
+}
+
+void IndexManager::invalidate(Wine::Properties property)
+{
+	stopWarmUp();
+	std::lock_guard<std::mutex> lock(stateMutex);
+	trees[(int)property].reset();
+	hashTables[(int)property].reset();
+	bPlusTrees[(int)property].reset();
+	flatHashTables[(int)property].reset();
+	postingIndexes[(int)property].reset();
+	if (property == Wine::Properties::RATING)
+		ratingIndex.reset();
+	if (property == Wine::Properties::PRICE)
+		priceIndex.reset();
+	for (int structure = 0; structure < NUM_STRUCTURES; structure++) {
+		states[structure][(int)property] = State::NOT_BUILT;
+		constructionTimes[structure][(int)property] = 0.0;
+		buildProgress[structure][(int)property] = 0.0f;
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "BPlusTree.h"
+#include "FlatHashTable.h"
+#include "HashTable.h"
+#include "NumericIndex.h"
+#include "PostingIndex.h"
+#include "RedBlackTree.h"
+#include "WineStore.h"
+
+// Owns one lazily built index per Wine::Properties and per data structure, so that repeated
+// queries reuse them instead of rebuilding. Call invalidate() whenever the store changes.
+// Indexes can also be warmed up on a pool of threads; any index that is finished can be searched
+// while the others are still building.
+class IndexManager {
+public:
+	enum class Structure { RED_BLACK_TREE, HASH_TABLE, B_PLUS_TREE, FLAT_HASH_TABLE };
+	// Called with the fraction of an index built so far (1.0 when done).
+	typedef std::function<void(float)> Progress;
+private:
+	enum class State { NOT_BUILT, BUILDING, BUILT };
+
+	static constexpr int NUM_PROPERTIES = 7;
+	static constexpr int NUM_STRUCTURES = 4;
+
+	WineStore& store;
+	std::unique_ptr<RedBlackTree> trees[NUM_PROPERTIES];
+	std::unique_ptr<HashTable> hashTables[NUM_PROPERTIES];
+	std::unique_ptr<BPlusTree> bPlusTrees[NUM_PROPERTIES];
+	std::unique_ptr<FlatHashTable> flatHashTables[NUM_PROPERTIES];
+	// RATING and PRICE are indexed once each, whatever structure is asked for.
+	std::unique_ptr<RatingIndex> ratingIndex;
+	std::unique_ptr<PriceIndex> priceIndex;
+	// Row id posting lists for the dictionary encoded properties.
+	std::unique_ptr<PostingIndex> postingIndexes[NUM_PROPERTIES];
+	// Whether posting indexes also keep every value's rows ordered by price and by rating.
+	bool preOrderedRows;
+	// Seconds it took to build each index.
+	double constructionTimes[NUM_STRUCTURES][NUM_PROPERTIES];
+	// Fraction of each index built so far.
+	std::atomic<float> buildProgress[NUM_STRUCTURES][NUM_PROPERTIES];
+
+	// Guards states (and the index pointers while they are being published).
+	mutable std::mutex stateMutex;
+	std::condition_variable stateChanged;
+	State states[NUM_STRUCTURES][NUM_PROPERTIES];
+
+	// Warm-up thread pool and the indexes it has yet to build.
+	vector<std::thread> warmUpThreads;
+	std::deque<std::pair<Structure, Wine::Properties>> warmUpJobs;
+	vector<std::pair<Structure, Wine::Properties>> warmUpIndexes;
+
+	void buildTree(Wine::Properties property, unsigned numThreads, const Progress& progress);
+	void buildHashTable(Wine::Properties property, const Progress& progress);
+	void buildBPlusTree(Wine::Properties property, const Progress& progress);
+	void buildFlatHashTable(Wine::Properties property, const Progress& progress);
+
+	// Builds the index unless it is built already. If another thread is building it, waits for it
+	// and reports the combined warm-up progress to progress in the meantime.
+	void ensureBuilt(Structure structure, Wine::Properties property, unsigned numThreads, const Progress& progress);
+
+	// Worker loop for warmUp().
+	void runWarmUpJobs();
+	// Drops the queued warm-up jobs and joins the pool.
+	void stopWarmUp();
+public:
+	IndexManager(WineStore& _store);
+	~IndexManager();
+
+	// Returns the index for property, building it first if needed.
+	RedBlackTree& getTree(Wine::Properties property, const Progress& progress = nullptr);
+	HashTable& getHashTable(Wine::Properties property, const Progress& progress = nullptr);
+	BPlusTree& getBPlusTree(Wine::Properties property, const Progress& progress = nullptr);
+	FlatHashTable& getFlatHashTable(Wine::Properties property, const Progress& progress = nullptr);
+	const RatingIndex& getRatingIndex();
+	const PriceIndex& getPriceIndex();
+	// property must be dictionary encoded (COUNTRY, PROVINCE or VARIETY).
+	const PostingIndex& getPostingIndex(Wine::Properties property);
+	// Makes posting indexes built from now on keep every value's rows ordered by price and by rating,
+	// trading two more row id arrays per property for top-K reads that sort nothing.
+	void setPreOrderedRows(bool enabled);
+	// Appends the count best wines whose property equals key, ordered by orderBy (PRICE or RATING) the way
+	// Wine::sortWine orders them. Returns false (appending nothing) if property has no pre-ordered posting index.
+	bool topRows(Wine::Properties property, std::string_view key, Wine::Properties orderBy, size_t count, vector<Wine*>& results);
+
+	// Builds the index if needed, without searching it.
+	void build(Structure structure, Wine::Properties property, const Progress& progress = nullptr);
+	// Appends every wine whose property equals key, building the index first if needed.
+	void search(Structure structure, Wine::Properties property, std::string_view key, vector<Wine*>& results);
+	// Ordered queries; they append matches in key order. Return false (without building anything) for
+	// structures that don't keep their keys ordered.
+	bool searchRange(Structure structure, Wine::Properties property, std::string_view low, std::string_view high, vector<Wine*>& results);
+	bool searchPrefix(Structure structure, Wine::Properties property, std::string_view prefix, vector<Wine*>& results);
+	static bool isOrdered(Structure structure);
+
+	// Install an index read from a snapshot, replacing any existing one. A posting index that doesn't match
+	// setPreOrderedRows() is dropped instead, so it is rebuilt when first used.
+	void setPostingIndex(Wine::Properties property, std::unique_ptr<PostingIndex> index);
+	void setRatingIndex(std::unique_ptr<RatingIndex> index);
+	void setPriceIndex(std::unique_ptr<PriceIndex> index);
+
+	// Starts building the Red-Black Tree and Hash Table for every string property on numThreads background threads and returns immediately.
+	void warmUp(unsigned numThreads);
+	// Combined fraction of the warm-up's indexes built so far (1.0 if there is no warm-up).
+	float getWarmUpProgress() const;
+
+	bool isBuilt(Structure structure, Wine::Properties property) const;
+	// True while some thread (such as the warm-up) is constructing the index.
+	bool isBuilding(Structure structure, Wine::Properties property) const;
+	// Seconds spent building the index, or 0 if it isn't built.
+	double getConstructionTime(Structure structure, Wine::Properties property) const;
+
+	// Drops every index (or only property's), so the next use rebuilds from the store.
+	// Stops any warm-up in progress first.
+	void invalidate();
+	void invalidate(Wine::Properties property);
+};
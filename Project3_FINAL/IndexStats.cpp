@@ -0,0 +1,122 @@
+#include "IndexStats.h"
+#include <iomanip>
+
+using namespace std;
+
+int Distribution::bucketOf(uint64_t value)
+{
+	int bucket = 0;
+	while (value != 0 && bucket < BUCKETS - 1) {
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void Distribution::add(uint64_t value, uint64_t times)
+{
+	counts[bucketOf(value)] += times;
+	count += times;
+	total += value * times;
+	if (times > 0 && value > max)
+		max = value;
+}
+
+double Distribution::mean() const
+{
+	return count == 0 ? 0 : (double)total / count;
+}
+
+void Distribution::print(ostream& output) const
+{
+	output << "n " << count << ", mean " << fixed << setprecision(2) << mean() << ", max " << max;
+	output.unsetf(ios::floatfield);
+	const char* separator = " | ";
+	for (int bucket = 0; bucket < BUCKETS; bucket++) {
+		if (counts[bucket] == 0)
+			continue;
+		uint64_t low = bucket == 0 ? 0 : (uint64_t)1 << (bucket - 1);
+		uint64_t high = bucket == 0 ? 0 : ((uint64_t)1 << bucket) - 1;
+		output << separator << low;
+		separator = ", ";
+		if (high > low)
+			output << "-" << high;
+		output << ": " << counts[bucket];
+	}
+}
+
+AtomicDistribution::AtomicDistribution()
+{
+	reset();
+}
+
+void AtomicDistribution::add(uint64_t value)
+{
+	counts[Distribution::bucketOf(value)].fetch_add(1, memory_order_relaxed);
+	count.fetch_add(1, memory_order_relaxed);
+	total.fetch_add(value, memory_order_relaxed);
+	uint64_t seen = max.load(memory_order_relaxed);
+	while (value > seen && !max.compare_exchange_weak(seen, value, memory_order_relaxed)) { }
+}
+
+Distribution AtomicDistribution::snapshot() const
+{
+	Distribution distribution;
+	for (int bucket = 0; bucket < Distribution::BUCKETS; bucket++)
+		distribution.counts[bucket] = counts[bucket].load(memory_order_relaxed);
+	distribution.count = count.load(memory_order_relaxed);
+	distribution.total = total.load(memory_order_relaxed);
+	distribution.max = max.load(memory_order_relaxed);
+	return distribution;
+}
+
+void AtomicDistribution::reset()
+{
+	for (atomic<uint64_t>& bucket : counts)
+		bucket.store(0, memory_order_relaxed);
+	count.store(0, memory_order_relaxed);
+	total.store(0, memory_order_relaxed);
+	max.store(0, memory_order_relaxed);
+}
+
+void HashTableStats::print(ostream& output) const
+{
+	output << "\tKeys: " << keys << " in " << capacity << " slots, load factor " << fixed << setprecision(3) << loadFactor
+		<< (rehashing ? " (rehash in progress)" : "") << endl;
+	output.unsetf(ios::floatfield);
+	output << "\tChain lengths: ";
+	chainLengths.print(output);
+	output << endl;
+#ifdef INDEX_STATS
+	output << "\tInsert probes: ";
+	insertProbes.print(output);
+	output << endl;
+	output << "\tSearch probes: ";
+	searchProbes.print(output);
+	output << endl;
+#else
+	output << "\tProbe lengths: not counted (build with INDEX_STATS defined)" << endl;
+#endif
+}
+
+void TreeStats::print(ostream& output) const
+{
+	output << "\tKeys: " << keys << ", height " << height << ", black height " << blackHeight
+		<< (blackHeight < 0 ? " (INVALID: paths differ)" : "") << endl;
+	output << "\tDuplicate list lengths: ";
+	duplicateLengths.print(output);
+	output << endl;
+	if (bulkLoadedNodes > 0)
+		output << "\tBulk load: " << bulkLoadedNodes << " nodes placed on " << bulkLoadLevels << " levels, no rotations" << endl;
+#ifdef INDEX_STATS
+	output << "\tRotations by insert(): " << leftRotations << " left, " << rightRotations << " right" << endl;
+	output << "\tComparisons per search: ";
+	searchComparisons.print(output);
+	output << endl;
+	output << "\tWine key reads per search: ";
+	searchKeyReads.print(output);
+	output << endl;
+#else
+	output << "\tRotations and comparisons: not counted (build with INDEX_STATS defined)" << endl;
+#endif
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Health reports for HashTable and RedBlackTree, dumped with the --index-stats command line flag.
+//
+// Shape figures (load factor, chain and duplicate list lengths, tree height) are computed by walking the
+// index when asked. The counters kept while it runs (probe lengths, rotations, comparisons per search) cost
+// an atomic add per operation, so they are only compiled in when INDEX_STATS is defined; otherwise
+// INDEX_STAT(...) expands to nothing, the counter members don't exist and their reports stay empty.
+#ifdef INDEX_STATS
+#define INDEX_STAT(statement) statement
+#else
+#define INDEX_STAT(statement)
+#endif
+
+// Histogram of non-negative values in power of two buckets: bucket 0 counts 0, bucket b counts [2^(b-1), 2^b).
+struct Distribution {
+	static constexpr int BUCKETS = 33;
+
+	uint64_t counts[BUCKETS] = {};
+	uint64_t count = 0;
+	uint64_t total = 0;
+	uint64_t max = 0;
+
+	static int bucketOf(uint64_t value);
+	void add(uint64_t value, uint64_t times = 1);
+	double mean() const;
+	// One line: count, mean and max, then every non-empty bucket as "range: count".
+	void print(std::ostream& output) const;
+};
+
+// Distribution that several threads (e.g. batch workers searching one index) can add to at once.
+class AtomicDistribution {
+private:
+	std::atomic<uint64_t> counts[Distribution::BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+public:
+	AtomicDistribution();
+
+	void add(uint64_t value);
+	Distribution snapshot() const;
+	void reset();
+};
+
+struct HashTableStats {
+	int keys = 0;
+	int capacity = 0;
+	// Keys over capacity (the new table while a rehash is in progress), the ratio insert() keeps under 0.5.
+	double loadFactor = 0;
+	bool rehashing = false;
+	// Wines per key.
+	Distribution chainLengths;
+	// Slots probed past a key's home slot by insert() and search(); empty without INDEX_STATS.
+	Distribution insertProbes;
+	Distribution searchProbes;
+
+	void print(std::ostream& output) const;
+};
+
+struct TreeStats {
+	size_t keys = 0;
+	// Nodes on the longest root to leaf path (0 for an empty tree).
+	int height = 0;
+	// Black nodes on every root to null path, or -1 if the paths disagree (a broken tree).
+	int blackHeight = 0;
+	// Wines per key (the key's node plus its duplicate list).
+	Distribution duplicateLengths;
+	// Nodes placed by the last loadSorted()/bulkLoad() and the levels they fill (both 0 for a tree built
+	// by insert()). A bulk load places every node directly, so it does no rotations.
+	uint64_t bulkLoadedNodes = 0;
+	int bulkLoadLevels = 0;
+	// Counted by rotateLeft()/rotateRight() during insert() and by the exact searches; zero or empty without INDEX_STATS.
+	uint64_t leftRotations = 0;
+	uint64_t rightRotations = 0;
+	Distribution searchComparisons;
+	// Comparisons per exact search that read the node's wine because the cached key prefix couldn't decide.
+	Distribution searchKeyReads;
+
+	void print(std::ostream& output) const;
+};
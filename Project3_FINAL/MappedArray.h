@@ -0,0 +1,149 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Read-only array whose elements either live in its own vector or are viewed in place in memory kept alive by
+// an owner, usually a mapped snapshot (see SnapshotReader::viewArray). Appending to a view copies it first,
+// so a store or index read from a snapshot can still be changed, at the cost of that one copy.
+template <typename T>
+class MappedArray {
+private:
+	std::vector<T> owned;
+	const T* items;
+	size_t count;
+	// Non-null while viewing memory outside owned.
+	std::shared_ptr<const void> owner;
+
+	void sync()
+	{
+		items = owned.data();
+		count = owned.size();
+	}
+	void own()
+	{
+		if (owner) {
+			owned.assign(items, items + count);
+			owner.reset();
+		}
+	}
+public:
+	MappedArray() : items(nullptr), count(0) { }
+	MappedArray(std::vector<T>&& values) : owned(std::move(values))
+	{
+		sync();
+	}
+	MappedArray(const MappedArray& other) : owned(other.owned), items(other.items), count(other.count), owner(other.owner)
+	{
+		if (!owner)
+			sync();
+	}
+	// A moved vector keeps its buffer, so items stays valid.
+	MappedArray(MappedArray&& other) noexcept : owned(std::move(other.owned)), items(other.items), count(other.count),
+		owner(std::move(other.owner))
+	{
+		other.clear();
+	}
+	MappedArray& operator=(MappedArray other) noexcept
+	{
+		owned.swap(other.owned);
+		std::swap(items, other.items);
+		std::swap(count, other.count);
+		owner.swap(other.owner);
+		return *this;
+	}
+	MappedArray& operator=(std::vector<T>&& values)
+	{
+		owned = std::move(values);
+		owner.reset();
+		sync();
+		return *this;
+	}
+
+	// Views _count elements at data, which must stay valid for as long as _owner is alive.
+	void view(const T* data, size_t _count, std::shared_ptr<const void> _owner)
+	{
+		owned.clear();
+		owned.shrink_to_fit();
+		items = data;
+		count = _count;
+		owner = std::move(_owner);
+	}
+	bool isView() const
+	{
+		return owner != nullptr;
+	}
+
+	void push_back(const T& value)
+	{
+		own();
+		owned.push_back(value);
+		sync();
+	}
+	void append(const T* values, size_t numValues)
+	{
+		own();
+		owned.insert(owned.end(), values, values + numValues);
+		sync();
+	}
+	void reserve(size_t capacity)
+	{
+		own();
+		owned.reserve(capacity);
+		sync();
+	}
+	void assign(size_t numValues, const T& value)
+	{
+		owner.reset();
+		owned.assign(numValues, value);
+		sync();
+	}
+	void clear()
+	{
+		owner.reset();
+		owned.clear();
+		sync();
+	}
+	void shrink_to_fit()
+	{
+		if (!owner) {
+			owned.shrink_to_fit();
+			sync();
+		}
+	}
+
+	const T* data() const
+	{
+		return items;
+	}
+	size_t size() const
+	{
+		return count;
+	}
+	bool empty() const
+	{
+		return count == 0;
+	}
+	const T& operator[](size_t index) const
+	{
+		return items[index];
+	}
+	const T& back() const
+	{
+		return items[count - 1];
+	}
+	const T* begin() const
+	{
+		return items;
+	}
+	const T* end() const
+	{
+		return items + count;
+	}
+	// Elements of memory the array occupies: its vector's capacity, or the viewed elements.
+	size_t capacity() const
+	{
+		return owner ? count : owned.capacity();
+	}
+};
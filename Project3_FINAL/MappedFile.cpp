@@ -0,0 +1,138 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : data(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) { }
+#else
+MappedFile::MappedFile() : data(nullptr), length(0), fileDescriptor(-1) { }
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	// Zero length files can't be mapped, but they are still valid (and empty).
+	if (length == 0)
+		return true;
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		close();
+		return false;
+	}
+	data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	data = nullptr;
+	length = 0;
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::isOpen() const
+{
+	return fileHandle != INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		return false;
+
+	struct stat fileInfo;
+	if (fstat(fileDescriptor, &fileInfo) != 0) {
+		close();
+		return false;
+	}
+	length = (size_t)fileInfo.st_size;
+	// Zero length files can't be mapped, but they are still valid (and empty).
+	if (length == 0)
+		return true;
+
+	void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(mapping, length, MADV_SEQUENTIAL);
+	data = static_cast<const char*>(mapping);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != nullptr)
+		munmap(const_cast<char*>(data), length);
+	if (fileDescriptor >= 0)
+		::close(fileDescriptor);
+	data = nullptr;
+	length = 0;
+	fileDescriptor = -1;
+}
+
+bool MappedFile::isOpen() const
+{
+	return fileDescriptor >= 0;
+}
+#endif
+
+const char* MappedFile::begin() const
+{
+	return data;
+}
+
+const char* MappedFile::end() const
+{
+	return data + length;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
+
+std::string_view MappedFile::view() const
+{
+	return std::string_view(data, length);
+}
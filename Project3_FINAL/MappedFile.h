@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of an entire file.
+// The mapped bytes stay valid until the object is closed or destroyed.
+class MappedFile {
+private:
+	const char* data;
+	size_t length;
+
+	// OS handles for the open file and its mapping.
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps the file at path. Returns false if it can't be opened or mapped.
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+	const char* begin() const;
+	const char* end() const;
+	size_t size() const;
+	std::string_view view() const;
+};
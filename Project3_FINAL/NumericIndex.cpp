@@ -0,0 +1,176 @@
+#include "NumericIndex.h"
+#include <algorithm>
+#include "Snapshot.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit. mask must not be zero.
+static inline unsigned lowestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctzll(mask);
+#endif
+}
+
+RatingIndex::RatingIndex() : minRating(0), numRows(0), numWords(0) { }
+
+RatingIndex::RatingIndex(const WineStore& store) : minRating(0), numRows(store.size()), numWords((store.size() + 63) / 64)
+{
+	const MappedArray<char>& ratings = store.getRatings();
+	if (ratings.empty())
+		return;
+	auto extremes = std::minmax_element(ratings.begin(), ratings.end());
+	minRating = *extremes.first;
+	size_t numValues = *extremes.second - minRating + 1;
+	vector<uint64_t> bits(numValues * numWords, 0);
+	vector<uint64_t> valueCounts(numValues, 0);
+	for (size_t id = 0; id < numRows; id++) {
+		bits[(ratings[id] - minRating) * numWords + id / 64] |= (uint64_t)1 << (id % 64);
+		valueCounts[ratings[id] - minRating]++;
+	}
+	bitmaps = std::move(bits);
+	counts = std::move(valueCounts);
+}
+
+void RatingIndex::writeSnapshot(SnapshotWriter& writer) const
+{
+	writer.writeU64((uint64_t)(int64_t)minRating);
+	writer.writeU64(numRows);
+	writer.writeArray(bitmaps);
+	writer.writeArray(counts);
+}
+
+bool RatingIndex::readSnapshot(SnapshotReader& reader, const WineStore& store)
+{
+	uint64_t minimum, rows;
+	bool valid = reader.readU64(minimum) && reader.readU64(rows) && reader.viewArray(bitmaps) && reader.viewArray(counts);
+	minRating = (int)(int64_t)minimum;
+	numRows = (size_t)rows;
+	numWords = (numRows + 63) / 64;
+	// A bitmap per counted rating, covering exactly the store's rows.
+	valid = valid && numRows == store.size() && counts.empty() == (numRows == 0) && bitmaps.size() == counts.size() * numWords
+		&& counts.size() <= 256;
+	if (!valid) {
+		*this = RatingIndex();
+		return false;
+	}
+	return true;
+}
+
+void RatingIndex::valueRange(int low, int high, int& first, int& last) const
+{
+	// Clamps before subtracting, so open bounds like INT_MIN can't overflow.
+	first = std::max(low, minRating) - minRating;
+	last = std::min(high, minRating + (int)counts.size() - 1) - minRating;
+}
+
+void RatingIndex::rangeBitmap(int low, int high, vector<uint64_t>& bits) const
+{
+	bits.assign(numWords, 0);
+	int first, last;
+	valueRange(low, high, first, last);
+	for (int value = first; value <= last; value++) {
+		const uint64_t* bitmap = bitmaps.data() + value * numWords;
+		for (size_t word = 0; word < bits.size(); word++)
+			bits[word] |= bitmap[word];
+	}
+}
+
+void RatingIndex::searchRange(int low, int high, vector<WineStore::RowId>& rows) const
+{
+	vector<uint64_t> bits;
+	rangeBitmap(low, high, bits);
+	rows.reserve(rows.size() + count(low, high));
+	for (size_t word = 0; word < bits.size(); word++) {
+		for (uint64_t mask = bits[word]; mask != 0; mask &= mask - 1)
+			rows.push_back((WineStore::RowId)(word * 64 + lowestBit(mask)));
+	}
+}
+
+size_t RatingIndex::count(int low, int high) const
+{
+	size_t total = 0;
+	int first, last;
+	valueRange(low, high, first, last);
+	for (int value = first; value <= last; value++)
+		total += counts[value];
+	return total;
+}
+
+bool RatingIndex::contains(const vector<uint64_t>& bits, WineStore::RowId id)
+{
+	return (bits[id / 64] >> (id % 64)) & 1;
+}
+
+PriceIndex::PriceIndex() { }
+
+PriceIndex::PriceIndex(const WineStore& store)
+{
+	const MappedArray<int>& columnPrices = store.getPrices();
+	vector<WineStore::RowId> sorted;
+	for (WineStore::RowId id = 0; id < columnPrices.size(); id++) {
+		if (columnPrices[id] != 0)
+			sorted.push_back(id);
+	}
+	// Stable, so rows with the same price stay in row id order.
+	std::stable_sort(sorted.begin(), sorted.end(), [&](WineStore::RowId row1, WineStore::RowId row2) {
+		return columnPrices[row1] < columnPrices[row2];
+	});
+	vector<int> sortedPrices;
+	sortedPrices.reserve(sorted.size());
+	for (WineStore::RowId id : sorted)
+		sortedPrices.push_back(columnPrices[id]);
+	rows = std::move(sorted);
+	prices = std::move(sortedPrices);
+}
+
+void PriceIndex::writeSnapshot(SnapshotWriter& writer) const
+{
+	writer.writeArray(prices);
+	writer.writeArray(rows);
+}
+
+bool PriceIndex::readSnapshot(SnapshotReader& reader, const WineStore& store)
+{
+	bool valid = reader.viewArray(prices) && reader.viewArray(rows) && prices.size() == rows.size() && rows.size() <= store.size();
+	for (size_t i = 0; valid && i < rows.size(); i++)
+		valid = rows[i] < store.size();
+	if (!valid) {
+		*this = PriceIndex();
+		return false;
+	}
+	return true;
+}
+
+void PriceIndex::bounds(int low, int high, size_t& first, size_t& last) const
+{
+	first = std::lower_bound(prices.begin(), prices.end(), low) - prices.begin();
+	last = std::upper_bound(prices.begin() + first, prices.end(), high) - prices.begin();
+}
+
+void PriceIndex::searchRange(int low, int high, vector<WineStore::RowId>& results) const
+{
+	size_t first, last;
+	bounds(low, high, first, last);
+	results.insert(results.end(), rows.begin() + first, rows.begin() + last);
+}
+
+void PriceIndex::searchRangeByRow(int low, int high, vector<WineStore::RowId>& results) const
+{
+	size_t start = results.size();
+	searchRange(low, high, results);
+	std::sort(results.begin() + start, results.end());
+}
+
+size_t PriceIndex::count(int low, int high) const
+{
+	size_t first, last;
+	bounds(low, high, first, last);
+	return last - first;
+}
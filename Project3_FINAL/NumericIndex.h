@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MappedArray.h"
+#include "WineStore.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Secondary indexes over the numeric columns, answering inclusive range predicates with sorted row ids
+// instead of scanning every row.
+
+// One bitmap over all rows per rating value. Ratings span a few dozen values (about 80 to 100), so a range
+// ORs a handful of bitmaps together and reads the set bits back in row order.
+class RatingIndex {
+private:
+	int minRating;
+	size_t numRows;
+	// Words per bitmap: (numRows + 63) / 64.
+	size_t numWords;
+	// The bitmaps back to back; bitmap r - minRating has bit i set when row i is rated r.
+	MappedArray<uint64_t> bitmaps;
+	// counts[r - minRating] is the number of rows rated r.
+	MappedArray<uint64_t> counts;
+
+	// Indexes of the bitmaps covering the ratings in [low, high]; first > last when there are none.
+	void valueRange(int low, int high, int& first, int& last) const;
+public:
+	// Empty index over no rows; readSnapshot() fills it.
+	RatingIndex();
+	RatingIndex(const WineStore& store);
+
+	// Writes the bitmaps and counts. readSnapshot() replaces the contents with views of them; it returns
+	// false (leaving the index empty) if they don't cover store's rows.
+	void writeSnapshot(SnapshotWriter& writer) const;
+	bool readSnapshot(SnapshotReader& reader, const WineStore& store);
+
+	// Sets bits to the rows rated in [low, high], one bit per row.
+	void rangeBitmap(int low, int high, vector<uint64_t>& bits) const;
+	// Appends the rows rated in [low, high], in ascending row id order.
+	void searchRange(int low, int high, vector<WineStore::RowId>& rows) const;
+	// Number of rows rated in [low, high], without touching the bitmaps.
+	size_t count(int low, int high) const;
+
+	static bool contains(const vector<uint64_t>& bits, WineStore::RowId id);
+};
+
+// Row ids sorted by price (row id order within a price) next to their prices, searched by binary search.
+// Rows without a price (0, shown as N/A) are left out, so no price range matches them.
+class PriceIndex {
+private:
+	MappedArray<int> prices;
+	MappedArray<WineStore::RowId> rows;
+
+	// Positions in the sorted columns of the rows priced in [low, high].
+	void bounds(int low, int high, size_t& first, size_t& last) const;
+public:
+	// Empty index over no rows; readSnapshot() fills it.
+	PriceIndex();
+	PriceIndex(const WineStore& store);
+
+	// Writes both sorted columns. readSnapshot() replaces the contents with views of them; it returns
+	// false (leaving the index empty) if they don't fit store.
+	void writeSnapshot(SnapshotWriter& writer) const;
+	bool readSnapshot(SnapshotReader& reader, const WineStore& store);
+
+	// Appends the rows priced in [low, high], cheapest first.
+	void searchRange(int low, int high, vector<WineStore::RowId>& results) const;
+	// Appends the rows priced in [low, high], in ascending row id order.
+	void searchRangeByRow(int low, int high, vector<WineStore::RowId>& results) const;
+	size_t count(int low, int high) const;
+};
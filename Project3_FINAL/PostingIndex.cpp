@@ -0,0 +1,150 @@
+#include "PostingIndex.h"
+#include <algorithm>
+#include "Snapshot.h"
+
+PostingIndex::PostingIndex() : dictionary(nullptr), preOrdered(false) { }
+
+PostingIndex::PostingIndex(const WineStore& store, Wine::Properties property, bool preOrder) : dictionary(store.getDictionary(property)), preOrdered(false)
+{
+	const MappedArray<WineStore::Code>* codes = nullptr;
+	switch (property) {
+	case Wine::Properties::COUNTRY:
+		codes = &store.getCountryCodes();
+		break;
+	case Wine::Properties::PROVINCE:
+		codes = &store.getProvinceCodes();
+		break;
+	case Wine::Properties::VARIETY:
+		codes = &store.getVarietyCodes();
+		break;
+	default:
+		break;
+	}
+	if (dictionary == nullptr || codes == nullptr) {
+		dictionary = nullptr;
+		return;
+	}
+
+	vector<uint64_t> counts(dictionary->size() + 1, 0);
+	for (WineStore::Code code : *codes)
+		counts[code + 1]++;
+	for (size_t code = 0; code < dictionary->size(); code++)
+		counts[code + 1] += counts[code];
+	offsets = std::move(counts);
+	vector<WineStore::RowId> grouped(codes->size());
+	vector<uint64_t> position(offsets.begin(), offsets.end() - 1);
+	for (WineStore::RowId id = 0; id < codes->size(); id++)
+		grouped[position[(*codes)[id]]++] = id;
+	rows = std::move(grouped);
+	if (!preOrder)
+		return;
+	preOrdered = true;
+
+	// Sorts every row once per order and then splits them by value, keeping each value's rows in sorted order.
+	const MappedArray<int>& prices = store.getPrices();
+	const MappedArray<char>& ratings = store.getRatings();
+	vector<WineStore::RowId> sorted(codes->size());
+	for (WineStore::RowId id = 0; id < sorted.size(); id++)
+		sorted[id] = id;
+	std::stable_sort(sorted.begin(), sorted.end(), [&](WineStore::RowId row1, WineStore::RowId row2) {
+		// Unsigned, so that a price of 0 (N/A) sorts after every real price.
+		return (unsigned)prices[row1] - 1 < (unsigned)prices[row2] - 1;
+	});
+	vector<WineStore::RowId> ordered;
+	regroup(*codes, sorted, ordered);
+	rowsByPrice = std::move(ordered);
+	for (WineStore::RowId id = 0; id < sorted.size(); id++)
+		sorted[id] = id;
+	std::stable_sort(sorted.begin(), sorted.end(), [&](WineStore::RowId row1, WineStore::RowId row2) {
+		return ratings[row1] > ratings[row2];
+	});
+	regroup(*codes, sorted, ordered);
+	rowsByRating = std::move(ordered);
+}
+
+void PostingIndex::regroup(const MappedArray<WineStore::Code>& codes, const vector<WineStore::RowId>& sorted, vector<WineStore::RowId>& ordered) const
+{
+	ordered.resize(sorted.size());
+	vector<uint64_t> position(offsets.begin(), offsets.end() - 1);
+	for (WineStore::RowId id : sorted)
+		ordered[position[codes[id]]++] = id;
+}
+
+void PostingIndex::writeSnapshot(SnapshotWriter& writer) const
+{
+	writer.writeU64(preOrdered ? 1 : 0);
+	writer.writeArray(offsets);
+	writer.writeArray(rows);
+	writer.writeArray(rowsByPrice);
+	writer.writeArray(rowsByRating);
+}
+
+bool PostingIndex::readSnapshot(SnapshotReader& reader, const WineStore& store, Wine::Properties property)
+{
+	uint64_t ordered;
+	dictionary = store.getDictionary(property);
+	bool valid = dictionary != nullptr && reader.readU64(ordered) && ordered <= 1 && reader.viewArray(offsets) &&
+		reader.viewArray(rows) && reader.viewArray(rowsByPrice) && reader.viewArray(rowsByRating);
+	preOrdered = valid && ordered == 1;
+
+	// Every row has to be listed under some code, and the pre-ordered arrays have to cover the same rows.
+	size_t orderedRows = preOrdered ? rows.size() : 0;
+	valid = valid && rows.size() == store.size() && offsets.size() == dictionary->size() + 1 && offsets[0] == 0 &&
+		offsets.back() == rows.size() && rowsByPrice.size() == orderedRows && rowsByRating.size() == orderedRows;
+	for (size_t code = 0; valid && code < dictionary->size(); code++)
+		valid = offsets[code] <= offsets[code + 1];
+	for (const MappedArray<WineStore::RowId>* ids : { &rows, &rowsByPrice, &rowsByRating }) {
+		for (size_t i = 0; valid && i < ids->size(); i++)
+			valid = (*ids)[i] < store.size();
+	}
+	if (!valid) {
+		*this = PostingIndex();
+		return false;
+	}
+	return true;
+}
+
+size_t PostingIndex::count(std::string_view key) const
+{
+	WineStore::Code code;
+	if (dictionary == nullptr || !dictionary->find(key, code))
+		return 0;
+	return offsets[code + 1] - offsets[code];
+}
+
+void PostingIndex::search(std::string_view key, vector<WineStore::RowId>& results) const
+{
+	WineStore::Code code;
+	if (dictionary == nullptr || !dictionary->find(key, code))
+		return;
+	results.insert(results.end(), rows.begin() + offsets[code], rows.begin() + offsets[code + 1]);
+}
+
+bool PostingIndex::isPreOrdered() const
+{
+	return preOrdered;
+}
+
+bool PostingIndex::top(std::string_view key, Wine::Properties orderBy, size_t count, vector<WineStore::RowId>& results) const
+{
+	const MappedArray<WineStore::RowId>* ordered;
+	switch (orderBy) {
+	case Wine::Properties::PRICE:
+		ordered = &rowsByPrice;
+		break;
+	case Wine::Properties::RATING:
+		ordered = &rowsByRating;
+		break;
+	default:
+		return false;
+	}
+	if (!preOrdered)
+		return false;
+	WineStore::Code code;
+	if (!dictionary->find(key, code))
+		return true;
+	size_t first = offsets[code];
+	size_t last = std::min(offsets[code + 1], first + count);
+	results.insert(results.end(), ordered->begin() + first, ordered->begin() + last);
+	return true;
+}
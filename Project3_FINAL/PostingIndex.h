@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MappedArray.h"
+#include "WineStore.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Inverted index over one dictionary encoded column (country, province or variety): for every value,
+// the ids of the rows holding it in ascending order. Built by one counting sort over the codes.
+class PostingIndex {
+private:
+	const WineStore::Dictionary* dictionary;
+	// rows[offsets[code], offsets[code + 1]) lists the rows holding code.
+	MappedArray<uint64_t> offsets;
+	MappedArray<WineStore::RowId> rows;
+	// Same groups as rows, each ordered like Wine::priceComp (cheapest first, N/A last) and like
+	// Wine::ratingComp (best first), ties in row id order. Empty unless built with preOrder.
+	MappedArray<WineStore::RowId> rowsByPrice;
+	MappedArray<WineStore::RowId> rowsByRating;
+	bool preOrdered;
+
+	// Fills ordered with rows regrouped by code, each group in the order of sorted.
+	void regroup(const MappedArray<WineStore::Code>& codes, const vector<WineStore::RowId>& sorted, vector<WineStore::RowId>& ordered) const;
+public:
+	// Empty index over no property; readSnapshot() fills it.
+	PostingIndex();
+	// property must be dictionary encoded (see WineStore::getDictionary).
+	// With preOrder, also keeps every value's rows ordered by price and by rating, so that top() is a prefix read.
+	PostingIndex(const WineStore& store, Wine::Properties property, bool preOrder = false);
+
+	// Writes the offsets and row arrays. readSnapshot() replaces the contents with views of them over store's
+	// property; it returns false (leaving the index empty) if they don't fit store.
+	void writeSnapshot(SnapshotWriter& writer) const;
+	bool readSnapshot(SnapshotReader& reader, const WineStore& store, Wine::Properties property);
+
+	// Number of rows holding key.
+	size_t count(std::string_view key) const;
+	// Appends the rows holding key, in ascending row id order.
+	void search(std::string_view key, vector<WineStore::RowId>& results) const;
+
+	bool isPreOrdered() const;
+	// Appends the first count rows holding key ordered by orderBy (PRICE or RATING) the way Wine::sortWine orders them.
+	// Returns false if the index wasn't built with preOrder.
+	bool top(std::string_view key, Wine::Properties orderBy, size_t count, vector<WineStore::RowId>& results) const;
+};
@@ -0,0 +1,271 @@
+#include "QueryEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+
+namespace {
+	// intersect() gallops once the longer list is this many times the shorter.
+	const size_t GALLOP_RATIO = 16;
+	// A step filters the running result instead of fetching postings once the posting list is
+	// estimated to be this many times longer than the result.
+	const size_t FILTER_RATIO = 8;
+}
+
+Predicate Predicate::equals(Wine::Properties property, const std::string& key)
+{
+	return Predicate{ property, key, 0, 0 };
+}
+
+Predicate Predicate::between(Wine::Properties property, int low, int high)
+{
+	return Predicate{ property, std::string(), low, high };
+}
+
+std::string Predicate::toString() const
+{
+	// Open range bounds are left out.
+	auto range = [this](const std::string& name) {
+		if (low == std::numeric_limits<int>::min())
+			return name + " <= " + std::to_string(high);
+		if (high == std::numeric_limits<int>::max())
+			return name + " >= " + std::to_string(low);
+		return name + " in [" + std::to_string(low) + ", " + std::to_string(high) + "]";
+	};
+	switch (property) {
+	case Wine::Properties::VARIETY:
+		return "variety = \"" + key + "\"";
+	case Wine::Properties::COUNTRY:
+		return "country = \"" + key + "\"";
+	case Wine::Properties::TITLE:
+		return "title = \"" + key + "\"";
+	case Wine::Properties::PROVINCE:
+		return "province = \"" + key + "\"";
+	case Wine::Properties::RATING:
+		return range("rating");
+	case Wine::Properties::PRICE:
+		return range("price");
+	default:
+		return "true";
+	}
+}
+
+QueryEngine::QueryEngine(WineStore& _store, IndexManager& _indexes) : store(_store), indexes(_indexes) { }
+
+size_t QueryEngine::estimate(const Predicate& predicate)
+{
+	switch (predicate.property) {
+	case Wine::Properties::VARIETY:
+	case Wine::Properties::COUNTRY:
+	case Wine::Properties::PROVINCE:
+		return indexes.getPostingIndex(predicate.property).count(predicate.key);
+	case Wine::Properties::TITLE: {
+		// Titles have no dictionary, so they are assumed to be spread evenly over the distinct titles.
+		size_t distinct = std::max(1, indexes.getHashTable(Wine::Properties::TITLE).size());
+		return (store.size() + distinct - 1) / distinct;
+	}
+	case Wine::Properties::RATING:
+		return indexes.getRatingIndex().count(predicate.low, predicate.high);
+	case Wine::Properties::PRICE:
+		return indexes.getPriceIndex().count(predicate.low, predicate.high);
+	default:
+		return store.size();
+	}
+}
+
+void QueryEngine::postings(const Predicate& predicate, std::vector<WineStore::RowId>& rows)
+{
+	switch (predicate.property) {
+	case Wine::Properties::VARIETY:
+	case Wine::Properties::COUNTRY:
+	case Wine::Properties::PROVINCE:
+		indexes.getPostingIndex(predicate.property).search(predicate.key, rows);
+		break;
+	case Wine::Properties::TITLE: {
+		vector<Wine*> wines;
+		indexes.getHashTable(Wine::Properties::TITLE).search(predicate.key, wines);
+		size_t start = rows.size();
+		for (Wine* wine : wines)
+			rows.push_back(store.rowId(wine));
+		std::sort(rows.begin() + start, rows.end());
+		break;
+	}
+	case Wine::Properties::RATING:
+		indexes.getRatingIndex().searchRange(predicate.low, predicate.high, rows);
+		break;
+	case Wine::Properties::PRICE:
+		indexes.getPriceIndex().searchRangeByRow(predicate.low, predicate.high, rows);
+		break;
+	default:
+		for (WineStore::RowId id = 0; id < store.size(); id++)
+			rows.push_back(id);
+	}
+}
+
+void QueryEngine::filter(const Predicate& predicate, std::vector<WineStore::RowId>& rows)
+{
+	const MappedArray<WineStore::Code>* codes = nullptr;
+	switch (predicate.property) {
+	case Wine::Properties::VARIETY:
+		codes = &store.getVarietyCodes();
+		break;
+	case Wine::Properties::COUNTRY:
+		codes = &store.getCountryCodes();
+		break;
+	case Wine::Properties::PROVINCE:
+		codes = &store.getProvinceCodes();
+		break;
+	default:
+		break;
+	}
+
+	std::vector<WineStore::RowId>::iterator kept;
+	if (codes != nullptr) {
+		// Compares 16-bit codes rather than strings; a key missing from the dictionary matches nothing.
+		WineStore::Code code;
+		if (!store.getDictionary(predicate.property)->find(predicate.key, code)) {
+			rows.clear();
+			return;
+		}
+		kept = std::remove_if(rows.begin(), rows.end(), [&](WineStore::RowId id) { return (*codes)[id] != code; });
+	}
+	else if (predicate.property == Wine::Properties::TITLE) {
+		kept = std::remove_if(rows.begin(), rows.end(), [&](WineStore::RowId id) { return store.getTitle(id) != predicate.key; });
+	}
+	else if (predicate.property == Wine::Properties::RATING) {
+		kept = std::remove_if(rows.begin(), rows.end(), [&](WineStore::RowId id) {
+			return store.getRating(id) < predicate.low || store.getRating(id) > predicate.high;
+		});
+	}
+	else if (predicate.property == Wine::Properties::PRICE) {
+		kept = std::remove_if(rows.begin(), rows.end(), [&](WineStore::RowId id) {
+			int price = store.getPrice(id);
+			return price == 0 || price < predicate.low || price > predicate.high;
+		});
+	}
+	else {
+		return;
+	}
+	rows.erase(kept, rows.end());
+}
+
+bool QueryEngine::gallops(size_t length1, size_t length2)
+{
+	return std::min(length1, length2) * GALLOP_RATIO < std::max(length1, length2);
+}
+
+void QueryEngine::intersect(const std::vector<WineStore::RowId>& list1, const std::vector<WineStore::RowId>& list2,
+	std::vector<WineStore::RowId>& result)
+{
+	result.clear();
+	const std::vector<WineStore::RowId>& shorter = list1.size() <= list2.size() ? list1 : list2;
+	const std::vector<WineStore::RowId>& longer = list1.size() <= list2.size() ? list2 : list1;
+	result.reserve(shorter.size());
+
+	if (gallops(shorter.size(), longer.size())) {
+		// Doubles the step through the longer list until it passes the id, then binary searches that last step.
+		// Costs O(s log(l / s)) instead of O(s + l).
+		size_t position = 0;
+		for (WineStore::RowId id : shorter) {
+			size_t step = 1;
+			size_t bound = position;
+			while (bound < longer.size() && longer[bound] < id) {
+				position = bound + 1;
+				bound += step;
+				step *= 2;
+			}
+			position = std::lower_bound(longer.begin() + position, longer.begin() + std::min(bound, longer.size()), id) - longer.begin();
+			if (position == longer.size())
+				break;
+			if (longer[position] == id)
+				result.push_back(id);
+		}
+		return;
+	}
+
+	// Linear merge, advancing both cursors without a data dependent branch.
+	size_t i = 0, j = 0;
+	while (i < shorter.size() && j < longer.size()) {
+		WineStore::RowId a = shorter[i], b = longer[j];
+		if (a == b)
+			result.push_back(a);
+		i += a <= b;
+		j += b <= a;
+	}
+}
+
+void QueryEngine::run(const std::vector<Predicate>& predicates, std::vector<WineStore::RowId>& rows, Plan* plan)
+{
+	auto queryStart = std::chrono::high_resolution_clock::now();
+	rows.clear();
+	if (plan != nullptr)
+		plan->steps.clear();
+
+	// Orders the predicates by their estimated row counts, most selective first.
+	std::vector<std::pair<size_t, const Predicate*>> order;
+	for (const Predicate& predicate : predicates)
+		order.emplace_back(estimate(predicate), &predicate);
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<size_t, const Predicate*>& step1, const std::pair<size_t, const Predicate*>& step2) {
+		return step1.first < step2.first;
+	});
+
+	if (order.empty()) {
+		postings(Predicate{ Wine::Properties::NONE, std::string(), 0, 0 }, rows);
+	}
+	double estimatedResult = (double)store.size();
+	std::vector<WineStore::RowId> list, intersection;
+	for (size_t i = 0; i < order.size(); i++) {
+		auto stepStart = std::chrono::high_resolution_clock::now();
+		const Predicate& predicate = *order[i].second;
+		PlanStep step{ predicate.toString(), "", order[i].first, 0, 0.0, 0, 0.0 };
+		estimatedResult *= store.empty() ? 0.0 : (double)order[i].first / store.size();
+
+		if (i == 0) {
+			step.method = "scan";
+			postings(predicate, rows);
+			step.postingRows = rows.size();
+		}
+		else if (rows.empty()) {
+			step.method = "skipped";
+		}
+		else if (rows.size() * FILTER_RATIO < order[i].first) {
+			step.method = "filter";
+			filter(predicate, rows);
+		}
+		else {
+			list.clear();
+			postings(predicate, list);
+			step.postingRows = list.size();
+			step.method = gallops(rows.size(), list.size()) ? "gallop" : "intersect";
+			intersect(rows, list, intersection);
+			rows.swap(intersection);
+		}
+
+		step.estimatedResult = estimatedResult;
+		step.actualResult = rows.size();
+		step.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - stepStart).count();
+		if (plan != nullptr)
+			plan->steps.push_back(step);
+	}
+	if (plan != nullptr)
+		plan->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - queryStart).count();
+}
+
+void QueryEngine::Plan::print(std::ostream& out) const
+{
+	out << "EXPLAIN" << std::endl;
+	out << "  " << std::left << std::setw(4) << "#" << std::setw(40) << "Predicate" << std::setw(11) << "Method" << std::right
+		<< std::setw(12) << "Est. rows" << std::setw(12) << "Postings" << std::setw(12) << "Est. left" << std::setw(12) << "Left"
+		<< std::setw(10) << "ms" << std::endl;
+	for (size_t i = 0; i < steps.size(); i++) {
+		const PlanStep& step = steps[i];
+		std::string predicate = step.predicate.size() > 38 ? step.predicate.substr(0, 35) + "..." : step.predicate;
+		out << "  " << std::left << std::setw(4) << i + 1 << std::setw(40) << predicate << std::setw(11) << step.method << std::right
+			<< std::setw(12) << step.estimatedRows << std::setw(12) << step.postingRows << std::setw(12) << (size_t)(step.estimatedResult + 0.5)
+			<< std::setw(12) << step.actualResult << std::setw(10) << std::fixed << std::setprecision(3) << step.milliseconds << std::endl;
+		out.unsetf(std::ios::floatfield);
+	}
+	out << "  Total: " << std::fixed << std::setprecision(3) << milliseconds << " ms" << std::endl;
+	out.unsetf(std::ios::floatfield);
+	out << std::setprecision(6);
+}
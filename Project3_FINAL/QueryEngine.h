@@ -0,0 +1,69 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "IndexManager.h"
+#include "WineStore.h"
+
+// One condition of a conjunctive query: an exact match on a string property, or an inclusive range
+// on RATING or PRICE. Wines without a price never match a PRICE range.
+struct Predicate {
+	Wine::Properties property;
+	std::string key;
+	int low, high;
+
+	static Predicate equals(Wine::Properties property, const std::string& key);
+	static Predicate between(Wine::Properties property, int low, int high);
+
+	std::string toString() const;
+};
+
+// Answers a conjunction of predicates with sorted row id posting lists taken from the indexes.
+// Predicates run from the most to the least selective by estimated row count. Each step either
+// intersects the running result with the predicate's posting list (galloping when one list is much
+// shorter), or checks the predicate on each remaining row when the result is already much smaller
+// than the list would be.
+class QueryEngine {
+public:
+	// One line of the EXPLAIN output.
+	struct PlanStep {
+		std::string predicate;
+		// "scan" (first step), "intersect", "gallop", "filter" or "skipped" (result already empty).
+		std::string method;
+		// Rows matching the predicate alone: estimated, and read from the index (0 for "filter").
+		size_t estimatedRows;
+		size_t postingRows;
+		// Rows left after this step: estimated assuming independent predicates, and actual.
+		double estimatedResult;
+		size_t actualResult;
+		double milliseconds;
+	};
+
+	struct Plan {
+		std::vector<PlanStep> steps;
+		double milliseconds;
+		void print(std::ostream& out) const;
+	};
+private:
+	WineStore& store;
+	IndexManager& indexes;
+
+	// Row count estimate for predicate on its own, from the index's statistics.
+	size_t estimate(const Predicate& predicate);
+	// Appends the rows matching predicate, in ascending row id order.
+	void postings(const Predicate& predicate, std::vector<WineStore::RowId>& rows);
+	// Keeps the rows of rows that match predicate, reading the column directly.
+	void filter(const Predicate& predicate, std::vector<WineStore::RowId>& rows);
+public:
+	QueryEngine(WineStore& _store, IndexManager& _indexes);
+
+	// Sets rows to the ids of the wines matching every predicate, ascending. An empty conjunction matches every wine.
+	// Fills plan, if given, with each step's estimated and actual cardinalities.
+	void run(const std::vector<Predicate>& predicates, std::vector<WineStore::RowId>& rows, Plan* plan = nullptr);
+
+	// Sets result to the ids in both sorted lists. Gallops through the longer list when the shorter is much shorter.
+	static void intersect(const std::vector<WineStore::RowId>& list1, const std::vector<WineStore::RowId>& list2,
+		std::vector<WineStore::RowId>& result);
+	// Whether intersect() gallops for lists of these lengths.
+	static bool gallops(size_t length1, size_t length2);
+};
@@ -1,7 +1,12 @@
 #include "RedBlackTree.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <type_traits>
 
 void RedBlackTree::rotateLeft(RBNode* node)
 {
+	INDEX_STAT(leftRotations++);
 	RBNode* rightChild = node->right;
 	node->right = rightChild->left;
 	if (node->right != nullptr)
@@ -23,6 +28,7 @@ void RedBlackTree::rotateLeft(RBNode* node)
 
 void RedBlackTree::rotateRight(RBNode* node)
 {
+	INDEX_STAT(rightRotations++);
 	RBNode* leftChild = node->left;
 	node->left = leftChild->right;
 	if (node->left != nullptr)
@@ -90,81 +96,239 @@ void RedBlackTree::balanceTree(RBNode* node)
 	}
 }
 
-RedBlackTree::RedBlackTree(int(*_comp)(const Wine*, const Wine*)) : root(nullptr)
+RedBlackTree::RedBlackTree() : root(nullptr) { }
+
+uint64_t RedBlackTree::keyPrefix(std::string_view key)
 {
-	nodeCompare = _comp;
+	uint64_t prefix = 0;
+	size_t length = key.size() < PREFIX_BYTES ? key.size() : PREFIX_BYTES;
+	for (size_t i = 0; i < length; i++)
+		prefix |= (uint64_t)(unsigned char)key[i] << (56 - 8 * i);
+	return prefix;
 }
 
-RedBlackTree::RedBlackTree(Wine::Properties _compBy) : root(nullptr)
+RedBlackTree::~RedBlackTree() { }
+
+std::unique_ptr<RedBlackTree> RedBlackTree::create(Wine::Properties property)
 {
-	switch (_compBy) {
+	switch (property) {
 	case Wine::Properties::VARIETY:
-		nodeCompare = Wine::varietyComp;
-		break;
-	case Wine::Properties::PROVINCE:
-		nodeCompare = Wine::provinceComp;
-		break;
-	case Wine::Properties::TITLE:
-		nodeCompare = Wine::titleComp;
-		break;
+		return std::unique_ptr<RedBlackTree>(new BasicRedBlackTree<VarietyKey>());
 	case Wine::Properties::COUNTRY:
-		nodeCompare = Wine::countryComp;
-		break;
+		return std::unique_ptr<RedBlackTree>(new BasicRedBlackTree<CountryKey>());
+	case Wine::Properties::PROVINCE:
+		return std::unique_ptr<RedBlackTree>(new BasicRedBlackTree<ProvinceKey>());
 	default:
-		nodeCompare = Wine::titleComp;
+		return std::unique_ptr<RedBlackTree>(new BasicRedBlackTree<TitleKey>());
 	}
 }
 
-void RedBlackTree::recursiveDestructor(RBNode* node)
+template <class KeyExtractor, class Compare>
+BasicRedBlackTree<KeyExtractor, Compare>::BasicRedBlackTree(KeyExtractor _key, Compare _compare) : key(_key), compare(_compare) { }
+
+template <class KeyExtractor, class Compare>
+std::string_view BasicRedBlackTree<KeyExtractor, Compare>::nodeKey(const Wine* wine) const
 {
-	if (node != nullptr) {
-		recursiveDestructor(node->left);
-		recursiveDestructor(node->right);
-		duplicateNode* duplicate = node->next;
-		delete node;
-		while (duplicate != nullptr) {
-			duplicateNode* current = duplicate;
-			duplicate = duplicate->next;
-			delete current;
-		}
-	}
+	return key(wine);
 }
 
-RedBlackTree::~RedBlackTree() {
-	recursiveDestructor(root);
+template <class KeyExtractor, class Compare>
+int BasicRedBlackTree<KeyExtractor, Compare>::compareNode(const RBNode* node, std::string_view searchKey, uint64_t searchPrefix) const
+{
+	// The prefix orders keys the way comparing their bytes does, which only holds for KeyCompare.
+	if constexpr (!std::is_same<Compare, KeyCompare>::value)
+		return compare(key(node->data), searchKey);
+	if (node->prefix != searchPrefix)
+		return node->prefix < searchPrefix ? -1 : 1;
+	// Equal prefixes with a key that fits in them: the shorter key is the longer one's start (or they are equal).
+	if (node->keyLength <= PREFIX_BYTES || searchKey.size() <= PREFIX_BYTES)
+		return node->keyLength < searchKey.size() ? -1 : (node->keyLength > searchKey.size() ? 1 : 0);
+	return key(node->data).substr(PREFIX_BYTES).compare(searchKey.substr(PREFIX_BYTES));
+}
+
+template <class KeyExtractor, class Compare>
+bool BasicRedBlackTree<KeyExtractor, Compare>::readsWine(const RBNode* node, std::string_view searchKey, uint64_t searchPrefix) const
+{
+	if constexpr (!std::is_same<Compare, KeyCompare>::value)
+		return true;
+	return node->prefix == searchPrefix && node->keyLength > PREFIX_BYTES && searchKey.size() > PREFIX_BYTES;
 }
 
-void RedBlackTree::insert(Wine* w)
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::insert(Wine* w)
 {
+	std::string_view wineKey = key(w);
+	uint64_t winePrefix = keyPrefix(wineKey);
 	RBNode* parent = nullptr;
 	RBNode** current = &root; // Uses double pointer to keep track of current pointer location.
 	while (*current != nullptr) {
 		parent = *current;
-		if (nodeCompare((*current)->data, w) < 0) {
+		int comparison = compareNode(*current, wineKey, winePrefix);
+		if (comparison < 0) {
 			current = &((*current)->right);
 		}
-		else if (nodeCompare((*current)->data, w) > 0) {
+		else if (comparison > 0) {
 			current = &((*current)->left);
 		}
 		else {
-			duplicateNode* newDuplicate = new duplicateNode(w, (*current)->next);
+			duplicateNode* newDuplicate = nodeArena.create<duplicateNode>(w, (*current)->next);
 			(*current)->next = newDuplicate;
 			return;
 		}
 	}
-	*current = new RBNode(w, parent);
+	*current = nodeArena.create<RBNode>(w, parent, wineKey);
 
 	balanceTree(*current);
 }
 
-void RedBlackTree::search(Wine* searchKey, std::vector<Wine*>& results)
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::bulkLoad(std::vector<Wine*> wines, unsigned numThreads,
+	const std::function<void(float)>& progress)
+{
+	root = nullptr;
+	nodeArena.clear();
+	if (wines.empty())
+		return;
+
+	// Groups the wines by key in one hashing pass, so that only the distinct keys need sorting.
+	// groupSlots is an open addressing map from key to group id + 1 (0 marks an empty slot).
+	size_t slotMask = 1;
+	while (slotMask < wines.size() * 2)
+		slotMask <<= 1;
+	slotMask--;
+	std::vector<uint32_t> groupSlots(slotMask + 1, 0);
+	std::hash<std::string_view> hasher;
+	std::vector<std::pair<std::string_view, uint32_t>> keys;
+	std::vector<uint32_t> groupOf(wines.size());
+	for (size_t i = 0; i < wines.size(); i++) {
+		std::string_view wineKey = key(wines[i]);
+		size_t slot = hasher(wineKey) & slotMask;
+		while (groupSlots[slot] != 0 && keys[groupSlots[slot] - 1].first != wineKey)
+			slot = (slot + 1) & slotMask;
+		if (groupSlots[slot] == 0) {
+			keys.emplace_back(wineKey, (uint32_t)keys.size());
+			groupSlots[slot] = (uint32_t)keys.size();
+		}
+		groupOf[i] = groupSlots[slot] - 1;
+	}
+	if (progress)
+		progress(0.4f);
+
+	auto keyLess = [this](const std::pair<std::string_view, uint32_t>& k1, const std::pair<std::string_view, uint32_t>& k2) {
+		return compare(k1.first, k2.first) < 0;
+	};
+	if (numThreads <= 1 || keys.size() < 2 * (size_t)numThreads) {
+		std::sort(keys.begin(), keys.end(), keyLess);
+	}
+	else {
+		// Sorts equal slices in parallel, then merges neighbouring runs in parallel rounds.
+		std::vector<size_t> bounds;
+		for (unsigned i = 0; i <= numThreads; i++)
+			bounds.push_back(keys.size() * i / numThreads);
+		std::vector<std::thread> workers;
+		for (unsigned i = 0; i < numThreads; i++)
+			workers.emplace_back([&, i]() { std::sort(keys.begin() + bounds[i], keys.begin() + bounds[i + 1], keyLess); });
+		for (std::thread& worker : workers)
+			worker.join();
+
+		while (bounds.size() > 2) {
+			std::vector<size_t> merged;
+			workers.clear();
+			for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+				workers.emplace_back([&, i]() {
+					std::inplace_merge(keys.begin() + bounds[i], keys.begin() + bounds[i + 1], keys.begin() + bounds[i + 2], keyLess);
+				});
+				merged.push_back(bounds[i]);
+			}
+			for (std::thread& worker : workers)
+				worker.join();
+			if (bounds.size() % 2 == 0)
+				merged.push_back(bounds[bounds.size() - 2]); // Odd run out waits for the next round.
+			merged.push_back(bounds.back());
+			bounds.swap(merged);
+		}
+	}
+	if (progress)
+		progress(0.7f);
+
+	// Counting sort of the wines by their key's rank; stable, so each key's wines keep their input order.
+	size_t numGroups = keys.size();
+	std::vector<uint32_t> rank(numGroups);
+	for (size_t i = 0; i < numGroups; i++)
+		rank[keys[i].second] = (uint32_t)i;
+	std::vector<size_t> groupStarts(numGroups + 1, 0);
+	for (uint32_t group : groupOf)
+		groupStarts[rank[group] + 1]++;
+	for (size_t i = 0; i < numGroups; i++)
+		groupStarts[i + 1] += groupStarts[i];
+	std::vector<Wine*> sorted(wines.size());
+	std::vector<size_t> position(groupStarts.begin(), groupStarts.end() - 1);
+	for (size_t i = 0; i < wines.size(); i++)
+		sorted[position[rank[groupOf[i]]]++] = wines[i];
+	if (progress)
+		progress(0.85f);
+
+	loadSorted(sorted, groupStarts);
+}
+
+void RedBlackTree::loadSorted(const std::vector<Wine*>& sorted, const std::vector<size_t>& groupStarts)
+{
+	root = nullptr;
+	nodeArena.clear();
+	size_t numGroups = groupStarts.empty() ? 0 : groupStarts.size() - 1;
+	bulkLoadedNodes = numGroups;
+	bulkLoadLevels = 0;
+	if (numGroups == 0)
+		return;
+
+	// Every null link in a midpoint built tree sits on the last two levels. Coloring the last level red
+	// (unless it is the root) leaves every path with the same number of black nodes.
+	int height = 0;
+	while (((size_t)2 << height) - 1 < numGroups)
+		height++;
+	root = buildBalanced(sorted, groupStarts, 0, numGroups, nullptr, 0, height > 0 ? height : -1);
+	bulkLoadLevels = height + 1;
+}
+
+RedBlackTree::RBNode* RedBlackTree::buildBalanced(const std::vector<Wine*>& sorted, const std::vector<size_t>& groupStarts,
+	size_t first, size_t last, RBNode* parent, int depth, int redDepth)
+{
+	if (first >= last)
+		return nullptr;
+	size_t middle = first + (last - first) / 2;
+
+	// Matches insert(): the first wine heads the node and later duplicates are pushed onto the front of its list.
+	RBNode* node = nodeArena.create<RBNode>(sorted[groupStarts[middle]], parent, nodeKey(sorted[groupStarts[middle]]));
+	node->color = depth == redDepth ? RED : BLACK;
+	for (size_t i = groupStarts[middle] + 1; i < groupStarts[middle + 1]; i++)
+		node->next = nodeArena.create<duplicateNode>(sorted[i], node->next);
+
+	node->left = buildBalanced(sorted, groupStarts, first, middle, node, depth + 1, redDepth);
+	node->right = buildBalanced(sorted, groupStarts, middle + 1, last, node, depth + 1, redDepth);
+	return node;
+}
+
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::search(Wine* searchKey, std::vector<Wine*>& results)
+{
+	search(key(searchKey), results);
+}
+
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::search(std::string_view searchKey, std::vector<Wine*>& results)
 {
+	INDEX_STAT(uint64_t comparisons = 0);
+	INDEX_STAT(uint64_t keyReads = 0);
+	uint64_t searchPrefix = keyPrefix(searchKey);
 	RBNode* current = root;
 	while (current != nullptr) {
-		if (nodeCompare(current->data, searchKey) < 0) {
+		INDEX_STAT(comparisons++);
+		INDEX_STAT(keyReads += readsWine(current, searchKey, searchPrefix));
+		int comparison = compareNode(current, searchKey, searchPrefix);
+		if (comparison < 0) {
 			current = current->right;
 		}
-		else if (nodeCompare(current->data, searchKey) > 0) {
+		else if (comparison > 0) {
 			current = current->left;
 		}
 		else {
@@ -174,7 +338,156 @@ void RedBlackTree::search(Wine* searchKey, std::vector<Wine*>& results)
 				results.push_back(duplicates->data);
 				duplicates = duplicates->next;
 			}
-			return;
+			break;
 		}
 	}
-}
\ No newline at end of file
+	INDEX_STAT(searchComparisons.add(comparisons));
+	INDEX_STAT(searchKeyReads.add(keyReads));
+}
+
+const RedBlackTree::RBNode* RedBlackTree::leftmost(const RBNode* node)
+{
+	while (node != nullptr && node->left != nullptr)
+		node = node->left;
+	return node;
+}
+
+RedBlackTree::Iterator::Iterator(const RedBlackTree* _tree, const RBNode* _node) : tree(_tree), node(_node) { }
+
+std::string_view RedBlackTree::Iterator::key() const
+{
+	return tree->nodeKey(node->data);
+}
+
+void RedBlackTree::Iterator::rows(std::vector<Wine*>& results) const
+{
+	results.push_back(node->data);
+	for (duplicateNode* duplicate = node->next; duplicate != nullptr; duplicate = duplicate->next)
+		results.push_back(duplicate->data);
+}
+
+RedBlackTree::Iterator& RedBlackTree::Iterator::operator++()
+{
+	// The successor is the leftmost node of the right subtree, or else the first ancestor reached from its left.
+	if (node->right != nullptr) {
+		node = leftmost(node->right);
+		return *this;
+	}
+	const RBNode* child = node;
+	node = node->parent;
+	while (node != nullptr && child == node->right) {
+		child = node;
+		node = node->parent;
+	}
+	return *this;
+}
+
+bool RedBlackTree::Iterator::operator==(const Iterator& other) const
+{
+	return node == other.node;
+}
+
+bool RedBlackTree::Iterator::operator!=(const Iterator& other) const
+{
+	return !(*this == other);
+}
+
+RedBlackTree::Iterator RedBlackTree::begin() const
+{
+	return Iterator(this, leftmost(root));
+}
+
+RedBlackTree::Iterator RedBlackTree::end() const
+{
+	return Iterator(this, nullptr);
+}
+
+template <class KeyExtractor, class Compare>
+RedBlackTree::Iterator BasicRedBlackTree<KeyExtractor, Compare>::lowerBound(std::string_view searchKey) const
+{
+	uint64_t searchPrefix = keyPrefix(searchKey);
+	const RBNode* bound = nullptr;
+	for (const RBNode* current = root; current != nullptr; ) {
+		if (compareNode(current, searchKey, searchPrefix) >= 0) {
+			bound = current;
+			current = current->left;
+		}
+		else {
+			current = current->right;
+		}
+	}
+	return Iterator(this, bound);
+}
+
+template <class KeyExtractor, class Compare>
+RedBlackTree::Iterator BasicRedBlackTree<KeyExtractor, Compare>::upperBound(std::string_view searchKey) const
+{
+	uint64_t searchPrefix = keyPrefix(searchKey);
+	const RBNode* bound = nullptr;
+	for (const RBNode* current = root; current != nullptr; ) {
+		if (compareNode(current, searchKey, searchPrefix) > 0) {
+			bound = current;
+			current = current->left;
+		}
+		else {
+			current = current->right;
+		}
+	}
+	return Iterator(this, bound);
+}
+
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::searchRange(std::string_view low, std::string_view high, std::vector<Wine*>& results) const
+{
+	for (Iterator current = lowerBound(low); current != end() && compare(current.key(), high) <= 0; ++current)
+		current.rows(results);
+}
+
+template <class KeyExtractor, class Compare>
+void BasicRedBlackTree<KeyExtractor, Compare>::searchPrefix(std::string_view prefix, std::vector<Wine*>& results) const
+{
+	// Keys starting with prefix are contiguous and none of them is less than prefix.
+	for (Iterator current = lowerBound(prefix); current != end() && current.key().substr(0, prefix.size()) == prefix; ++current)
+		current.rows(results);
+}
+
+int RedBlackTree::collectStats(const RBNode* node, int depth, TreeStats& stats)
+{
+	if (node == nullptr) {
+		if (depth > stats.height)
+			stats.height = depth;
+		return 0;
+	}
+	uint64_t length = 1;
+	for (duplicateNode* duplicate = node->next; duplicate != nullptr; duplicate = duplicate->next)
+		length++;
+	stats.keys++;
+	stats.duplicateLengths.add(length);
+
+	int leftBlackHeight = collectStats(node->left, depth + 1, stats);
+	int rightBlackHeight = collectStats(node->right, depth + 1, stats);
+	if (leftBlackHeight < 0 || leftBlackHeight != rightBlackHeight)
+		return -1;
+	return leftBlackHeight + (node->color == BLACK ? 1 : 0);
+}
+
+TreeStats RedBlackTree::getStats() const
+{
+	TreeStats stats;
+	stats.blackHeight = collectStats(root, 0, stats);
+	stats.bulkLoadedNodes = bulkLoadedNodes;
+	stats.bulkLoadLevels = bulkLoadLevels;
+#ifdef INDEX_STATS
+	stats.leftRotations = leftRotations;
+	stats.rightRotations = rightRotations;
+	stats.searchComparisons = searchComparisons.snapshot();
+	stats.searchKeyReads = searchKeyReads.snapshot();
+#endif
+	return stats;
+}
+
+template class BasicRedBlackTree<VarietyKey>;
+template class BasicRedBlackTree<CountryKey>;
+template class BasicRedBlackTree<TitleKey>;
+template class BasicRedBlackTree<ProvinceKey>;
+template class BasicRedBlackTree<RuntimeKey>;
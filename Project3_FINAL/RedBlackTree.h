@@ -1,9 +1,18 @@
 #pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include "Wine.h"
+#include "Arena.h"
+#include "IndexKeys.h"
+#include "IndexStats.h"
 
+// Red-Black Tree index over one string property, with the wines sharing a key chained off its node.
+// This class holds the nodes, balancing and everything that never reads a key; BasicRedBlackTree below
+// implements the key lookups for one key extractor, so that they inline. create() picks the one for a property.
 class RedBlackTree
 {
-private:
+protected:
 	enum Color { RED, BLACK };
 	// Struct for chaining duplicate keys:
 	struct duplicateNode
@@ -13,34 +22,141 @@ private:
 		duplicateNode(Wine* _data, duplicateNode* _next) : data(_data), next(_next) {}
 	};
 
+	// Number of leading key bytes cached in every node.
+	static constexpr uint32_t PREFIX_BYTES = 8;
+
 	// Struct for key nodes:
 	struct RBNode
 	{
 		Wine* data;
 		bool color;
+		// Length of the key and its first PREFIX_BYTES bytes (see keyPrefix), so that most comparisons on the
+		// way down are decided without loading data.
+		uint32_t keyLength;
+		uint64_t prefix;
 		RBNode* left, * right, * parent;
 		duplicateNode* next;
-		RBNode(Wine* _data, RBNode* _parent) : data(_data), left(nullptr), right(nullptr), next(nullptr), parent(_parent), color(RED) { }
+		RBNode(Wine* _data, RBNode* _parent, std::string_view key) : data(_data), color(RED), keyLength((uint32_t)key.size()),
+			prefix(keyPrefix(key)), left(nullptr), right(nullptr), parent(_parent), next(nullptr) { }
 	};
 
+	// The first PREFIX_BYTES bytes of key, zero padded, as a big-endian integer: keys with different
+	// prefixes compare like their prefixes do.
+	static uint64_t keyPrefix(std::string_view key);
+
 	RBNode* root;
-	// Function that dictates how search and insertion will be preformed, i.e. based on which wine property.
-	int (*nodeCompare)(const Wine*, const Wine*);
+	// Every RBNode and duplicateNode is bump allocated here and released together with the tree.
+	Arena nodeArena;
+
+	// What the last loadSorted() built; see TreeStats.
+	uint64_t bulkLoadedNodes = 0;
+	int bulkLoadLevels = 0;
+#ifdef INDEX_STATS
+	uint64_t leftRotations = 0;
+	uint64_t rightRotations = 0;
+	AtomicDistribution searchComparisons;
+	AtomicDistribution searchKeyReads;
+#endif
 
-	// Functions for self balancing nature of RBTree; 
+	// Functions for self balancing nature of RBTree;
 	void rotateLeft(RBNode* node);
 	void rotateRight(RBNode* node);
 	void balanceTree(RBNode* node);
 
-	// Recursive helper function for post-order traversal to deallocate all tree and duplicate nodes.
-	void recursiveDestructor(RBNode* node);
-
 	static RBNode* getUncle(RBNode* node);
+
+	// Adds node's subtree to stats; returns its black height, or -1 if two of its paths disagree.
+	static int collectStats(const RBNode* node, int depth, TreeStats& stats);
+
+	// Leftmost node of node's subtree.
+	static const RBNode* leftmost(const RBNode* node);
+
+	// Builds a perfectly balanced subtree over groups [first, last) of sorted (wines are grouped by key).
+	// Nodes on redDepth are colored red, every other node black.
+	RBNode* buildBalanced(const std::vector<Wine*>& sorted, const std::vector<size_t>& groupStarts,
+		size_t first, size_t last, RBNode* parent, int depth, int redDepth);
+
+	// The key wine is ordered by, for the nodes built here.
+	virtual std::string_view nodeKey(const Wine* wine) const = 0;
+
+	RedBlackTree();
+public:
+	// Walks the distinct keys in ascending order, following parent pointers. Stays valid until the next insert.
+	class Iterator
+	{
+	private:
+		const RedBlackTree* tree;
+		const RBNode* node;
+	public:
+		Iterator(const RedBlackTree* _tree = nullptr, const RBNode* _node = nullptr);
+
+		std::string_view key() const;
+		// Appends the wines with this key, in the order search() returns them.
+		void rows(std::vector<Wine*>& results) const;
+
+		Iterator& operator++();
+		bool operator==(const Iterator& other) const;
+		bool operator!=(const Iterator& other) const;
+	};
+
+	virtual ~RedBlackTree(); // Nodes live in nodeArena, so they are freed all at once.
+
+	// Returns an empty tree ordered by property (TITLE for properties that aren't strings).
+	static std::unique_ptr<RedBlackTree> create(Wine::Properties property);
+
+	virtual void insert(Wine* w) = 0;
+	// Replaces the tree's contents with wines. Groups them by key, sorts the distinct keys once (split over
+	// numThreads threads) and then builds a balanced, validly colored tree bottom up in linear time. Searches return the same wines
+	// in the same order as inserting them one at a time would.
+	// progress, if set, is called with the fraction done after the grouping, the sort and the regrouping.
+	virtual void bulkLoad(std::vector<Wine*> wines, unsigned numThreads = 1, const std::function<void(float)>& progress = nullptr) = 0;
+	// Replaces the tree's contents with groups of wines that are already in key order: group i is
+	// sorted[groupStarts[i], groupStarts[i + 1]) in insertion order. Skips the sort done by bulkLoad.
+	void loadSorted(const std::vector<Wine*>& sorted, const std::vector<size_t>& groupStarts);
+	virtual void search(Wine* key, std::vector<Wine*>& results) = 0; // Search returns a vector of all matching results.
+	virtual void search(std::string_view key, std::vector<Wine*>& results) = 0; // Same as above without needing a key Wine; allocates nothing beyond results.
+
+	Iterator begin() const;
+	Iterator end() const;
+	// First key that isn't less than key, or end().
+	virtual Iterator lowerBound(std::string_view key) const = 0;
+	// First key greater than key, or end().
+	virtual Iterator upperBound(std::string_view key) const = 0;
+
+	// Appends the wines of every key in [low, high], in key order. O(log n + k).
+	virtual void searchRange(std::string_view low, std::string_view high, std::vector<Wine*>& results) const = 0;
+	// Appends the wines of every key starting with prefix, in key order. O(log n + k).
+	virtual void searchPrefix(std::string_view prefix, std::vector<Wine*>& results) const = 0;
+
+	// Height, black height, duplicate list lengths and the bulk load's size, plus the rotations and search
+	// comparisons counted so far when built with INDEX_STATS.
+	TreeStats getStats() const;
+};
+
+// Tree whose keys are read by KeyExtractor and ordered by Compare (see IndexKeys.h). Defined in RedBlackTree.cpp
+// for PropertyKey of every string property and for RuntimeKey.
+template <class KeyExtractor, class Compare = KeyCompare>
+class BasicRedBlackTree : public RedBlackTree
+{
+private:
+	KeyExtractor key;
+	Compare compare;
+
+	// Three-way comparison of node's key with searchKey, whose keyPrefix is searchPrefix. Reads node's wine only
+	// when the cached prefix and length can't decide.
+	int compareNode(const RBNode* node, std::string_view searchKey, uint64_t searchPrefix) const;
+	// Whether compareNode() has to read node's wine, i.e. may miss the cache beyond the node itself.
+	bool readsWine(const RBNode* node, std::string_view searchKey, uint64_t searchPrefix) const;
+	std::string_view nodeKey(const Wine* wine) const override;
 public:
-	RedBlackTree(int(*_comp)(const Wine*, const Wine*));
-	RedBlackTree(Wine::Properties _searchBy);
-	~RedBlackTree(); // Uses a post order travresal to deallocate all tree nodes.
+	BasicRedBlackTree(KeyExtractor _key = KeyExtractor(), Compare _compare = Compare());
 
-	void insert(Wine* w);
-	void search(Wine* key, std::vector<Wine*>& results); // Search returns a vector of all matching results.
-};
\ No newline at end of file
+	void insert(Wine* w) override;
+	void bulkLoad(std::vector<Wine*> wines, unsigned numThreads = 1, const std::function<void(float)>& progress = nullptr) override;
+	void search(Wine* key, std::vector<Wine*>& results) override;
+	void search(std::string_view key, std::vector<Wine*>& results) override;
+	Iterator lowerBound(std::string_view key) const override;
+	Iterator upperBound(std::string_view key) const override;
+	void searchRange(std::string_view low, std::string_view high, std::vector<Wine*>& results) const override;
+	void searchPrefix(std::string_view prefix, std::vector<Wine*>& results) const override;
+};
@@ -0,0 +1,200 @@
+#include "Snapshot.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include "MappedFile.h"
+
+namespace {
+	constexpr char MAGIC[8] = { 'W', 'I', 'N', 'E', 'S', 'N', 'A', 'P' };
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		// Size and modification time of the CSV file the snapshot was taken from.
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		uint64_t payloadSize;
+		uint64_t checksum;
+	};
+
+	// The dictionary encoded properties whose posting indexes are stored, in payload order.
+	const Wine::Properties POSTING_PROPERTIES[] = {
+		Wine::Properties::VARIETY, Wine::Properties::COUNTRY, Wine::Properties::PROVINCE
+	};
+
+	size_t padding(size_t bytes)
+	{
+		return (8 - bytes % 8) % 8;
+	}
+
+	// FNV-1a over 8-byte words (with an extra shift to fold the high bits back in), so that
+	// verifying a snapshot runs at memory speed.
+	uint64_t checksum(const char* data, size_t size)
+	{
+		const uint64_t prime = 1099511628211ull;
+		uint64_t hash = 14695981039346656037ull;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ (unsigned char)data[i]) * prime;
+		return hash;
+	}
+
+	bool sourceStamp(const std::string& csvPath, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		size = std::filesystem::file_size(csvPath, error);
+		if (error)
+			return false;
+		time = (int64_t)std::filesystem::last_write_time(csvPath, error).time_since_epoch().count();
+		return !error;
+	}
+}
+
+void SnapshotWriter::write(const void* data, size_t bytes)
+{
+	buffer.append(static_cast<const char*>(data), bytes);
+	buffer.append(padding(bytes), '\0');
+}
+
+void SnapshotWriter::writeU64(uint64_t value)
+{
+	write(&value, sizeof(value));
+}
+
+const std::string& SnapshotWriter::bytes() const
+{
+	return buffer;
+}
+
+SnapshotReader::SnapshotReader(const char* _begin, const char* _end, std::shared_ptr<const void> _owner)
+	: cursor(_begin), end(_end), valid(true), owner(std::move(_owner)) { }
+
+bool SnapshotReader::take(size_t bytes, const char*& data)
+{
+	size_t padded = bytes + padding(bytes);
+	if (!valid || padded < bytes || padded > (size_t)(end - cursor)) {
+		valid = false;
+		return false;
+	}
+	data = cursor;
+	cursor += padded;
+	return true;
+}
+
+bool SnapshotReader::read(void* data, size_t bytes)
+{
+	const char* source;
+	if (!take(bytes, source))
+		return false;
+	if (bytes > 0)
+		memcpy(data, source, bytes);
+	return true;
+}
+
+bool SnapshotReader::readU64(uint64_t& value)
+{
+	return read(&value, sizeof(value));
+}
+
+bool SnapshotReader::ok() const
+{
+	return valid;
+}
+
+size_t SnapshotReader::remaining() const
+{
+	return end - cursor;
+}
+
+std::string Snapshot::pathFor(const std::string& csvPath)
+{
+	return csvPath + ".snapshot";
+}
+
+bool Snapshot::save(const std::string& snapshotPath, const std::string& csvPath, WineStore& store, IndexManager& indexes)
+{
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.headerSize = sizeof(Header);
+	if (!sourceStamp(csvPath, header.sourceSize, header.sourceTime))
+		return false;
+
+	SnapshotWriter writer;
+	store.writeSnapshot(writer);
+	for (Wine::Properties property : POSTING_PROPERTIES)
+		indexes.getPostingIndex(property).writeSnapshot(writer);
+	indexes.getRatingIndex().writeSnapshot(writer);
+	indexes.getPriceIndex().writeSnapshot(writer);
+
+	const std::string& payload = writer.bytes();
+	header.payloadSize = payload.size();
+	header.checksum = checksum(payload.data(), payload.size());
+
+	// Written to a temporary file first, so that a crash never leaves a half written snapshot behind.
+	std::string temporaryPath = snapshotPath + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(payload.data(), payload.size());
+		if (!file)
+			return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, snapshotPath, error);
+	return !error;
+}
+
+bool Snapshot::load(const std::string& snapshotPath, const std::string& csvPath, WineStore& store, IndexManager& indexes)
+{
+	indexes.invalidate();
+	store.clear();
+
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// Shared with every array viewing it, so the mapping outlives this function.
+	auto file = std::make_shared<MappedFile>();
+	if (!sourceStamp(csvPath, sourceSize, sourceTime) || !file->open(snapshotPath) || file->size() < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file->begin(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.headerSize != sizeof(Header) ||
+		header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.payloadSize != file->size() - sizeof(Header))
+		return false;
+	const char* payload = file->begin() + sizeof(Header);
+	if (checksum(payload, (size_t)header.payloadSize) != header.checksum)
+		return false;
+
+	SnapshotReader reader(payload, file->end(), file);
+	if (!store.readSnapshot(reader))
+		return false;
+	bool valid = true;
+	for (Wine::Properties property : POSTING_PROPERTIES) {
+		std::unique_ptr<PostingIndex> posting(new PostingIndex());
+		if (!(valid = posting->readSnapshot(reader, store, property)))
+			break;
+		indexes.setPostingIndex(property, std::move(posting));
+	}
+	std::unique_ptr<RatingIndex> ratingIndex(new RatingIndex());
+	std::unique_ptr<PriceIndex> priceIndex(new PriceIndex());
+	valid = valid && ratingIndex->readSnapshot(reader, store) && priceIndex->readSnapshot(reader, store);
+	if (valid) {
+		indexes.setRatingIndex(std::move(ratingIndex));
+		indexes.setPriceIndex(std::move(priceIndex));
+	}
+	if (!valid || !reader.ok() || reader.remaining() != 0) {
+		indexes.invalidate();
+		store.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IndexManager.h"
+#include "MappedArray.h"
+#include "WineStore.h"
+
+// Serializes values and arrays into a byte buffer. Arrays are padded to 8 bytes so that every
+// section of a snapshot stays aligned when the file is mapped.
+class SnapshotWriter {
+private:
+	std::string buffer;
+public:
+	void write(const void* data, size_t bytes);
+	void writeU64(uint64_t value);
+	// Writes the element count followed by the elements.
+	template <typename T>
+	void writeArray(const T* data, size_t count)
+	{
+		writeU64(count);
+		write(data, count * sizeof(T));
+	}
+	template <typename T>
+	void writeArray(const std::vector<T>& values)
+	{
+		writeArray(values.data(), values.size());
+	}
+	template <typename T>
+	void writeArray(const MappedArray<T>& values)
+	{
+		writeArray(values.data(), values.size());
+	}
+
+	const std::string& bytes() const;
+};
+
+// Reads what SnapshotWriter wrote from a mapped buffer. Every read is bounds checked; after the
+// first failed read, ok() is false and every later read fails too.
+class SnapshotReader {
+private:
+	const char* cursor;
+	const char* end;
+	bool valid;
+	// Keeps the buffer alive for the arrays viewing it; without one, arrays are copied out.
+	std::shared_ptr<const void> owner;
+
+	// Consumes bytes plus their padding, pointing data at them.
+	bool take(size_t bytes, const char*& data);
+public:
+	SnapshotReader(const char* _begin, const char* _end, std::shared_ptr<const void> _owner = nullptr);
+
+	bool read(void* data, size_t bytes);
+	bool readU64(uint64_t& value);
+	// Points values at the next array (as written by writeArray) in place, sharing ownership of the buffer.
+	// The writer pads every array to 8 bytes, so an array of a mapped snapshot is aligned for T.
+	template <typename T>
+	bool viewArray(MappedArray<T>& values)
+	{
+		uint64_t count;
+		const char* data;
+		if (!readU64(count) || count > (uint64_t)(end - cursor) / sizeof(T) || !take((size_t)count * sizeof(T), data)) {
+			valid = false;
+			return false;
+		}
+		if (owner && reinterpret_cast<uintptr_t>(data) % alignof(T) == 0) {
+			values.view(reinterpret_cast<const T*>(data), (size_t)count, owner);
+		}
+		else {
+			std::vector<T> copy((size_t)count);
+			if (count > 0)
+				memcpy(copy.data(), data, (size_t)count * sizeof(T));
+			values = std::move(copy);
+		}
+		return true;
+	}
+
+	bool ok() const;
+	size_t remaining() const;
+};
+
+// Binary snapshot of a WineStore and the array based indexes built over it.
+// It is written next to the CSV file and used instead of parsing as long as the CSV's size and modification time
+// match the ones recorded in its header.
+//
+// Layout: a fixed header (magic, format version, source size and mtime, payload size, payload checksum)
+// followed by the payload: the store's dictionaries, title heap and columns, then the posting index of every
+// dictionary encoded property and the rating and price indexes. Every section is a flat array of fixed width
+// values (row ids, codes, offsets into a heap), never a pointer, so loading maps the file and reads each
+// array in place. The pointer based indexes (trees and hash tables) aren't stored; they are built on first use.
+namespace Snapshot {
+	// Bump whenever the payload layout changes.
+	constexpr uint32_t VERSION = 4;
+
+	// Path of the snapshot kept for csvPath.
+	std::string pathFor(const std::string& csvPath);
+
+	// Builds any missing posting, rating or price index and writes the store and those indexes to snapshotPath,
+	// stamped with csvPath's current size and modification time. Returns false if the file can't be written.
+	bool save(const std::string& snapshotPath, const std::string& csvPath, WineStore& store, IndexManager& indexes);
+
+	// Replaces store and indexes with the snapshot's contents, viewed in the mapped file, which stays mapped for
+	// as long as they use it. Returns false (leaving the store empty) if the snapshot is missing, corrupt, from
+	// another format version, or older than the CSV file at csvPath.
+	bool load(const std::string& snapshotPath, const std::string& csvPath, WineStore& store, IndexManager& indexes);
+}
@@ -1,8 +1,102 @@
 #include "Wine.h"
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <thread>
+
+namespace {
+    // Bits sorted per radix pass.
+    const int RADIX_BITS = 8;
+    const size_t RADIX = 1 << RADIX_BITS;
+    // Wines per thread below which splitting a sort isn't worth starting a thread for.
+    const size_t MIN_WINES_PER_THREAD = 1 << 16;
+
+    // Stable LSD radix sort of wines by keys (keys[i] belongs to wines[i]), with one pass per digit of maxKey.
+    // Every pass splits the wines into numThreads contiguous chunks that are counted and scattered in parallel;
+    // each chunk's wines land after those of earlier chunks with the same digit, which keeps the sort stable.
+    void radixSort(vector<Wine*>& wines, vector<uint32_t>& keys, uint32_t maxKey, unsigned numThreads)
+    {
+        size_t size = wines.size();
+        numThreads = (unsigned)std::max<size_t>(1, std::min<size_t>(numThreads, size / MIN_WINES_PER_THREAD));
+        auto forEachChunk = [&](const auto& work) {
+            vector<std::thread> threads;
+            for (unsigned chunk = 1; chunk < numThreads; chunk++)
+                threads.emplace_back(work, chunk, size * chunk / numThreads, size * (chunk + 1) / numThreads);
+            work(0, 0, size / numThreads);
+            for (std::thread& thread : threads)
+                thread.join();
+        };
+
+        vector<Wine*> sortedWines(size);
+        vector<uint32_t> sortedKeys(size);
+        // positions[chunk * RADIX + digit] counts the chunk's wines with digit, then becomes where the next one goes.
+        vector<size_t> positions(numThreads * RADIX);
+        for (int shift = 0; shift < 32 && (maxKey >> shift) != 0; shift += RADIX_BITS) {
+            std::fill(positions.begin(), positions.end(), 0);
+            forEachChunk([&](unsigned chunk, size_t first, size_t last) {
+                size_t* counts = &positions[chunk * RADIX];
+                for (size_t i = first; i < last; i++)
+                    counts[(keys[i] >> shift) & (RADIX - 1)]++;
+            });
+
+            size_t position = 0;
+            bool oneDigit = false;
+            for (size_t digit = 0; digit < RADIX; digit++) {
+                size_t start = position;
+                for (unsigned chunk = 0; chunk < numThreads; chunk++) {
+                    size_t count = positions[chunk * RADIX + digit];
+                    positions[chunk * RADIX + digit] = position;
+                    position += count;
+                }
+                oneDigit |= position - start == size;
+            }
+            // Every wine has the same digit, so this pass wouldn't move anything.
+            if (oneDigit)
+                continue;
+
+            forEachChunk([&](unsigned chunk, size_t first, size_t last) {
+                size_t* next = &positions[chunk * RADIX];
+                for (size_t i = first; i < last; i++) {
+                    size_t position = next[(keys[i] >> shift) & (RADIX - 1)]++;
+                    sortedWines[position] = wines[i];
+                    sortedKeys[position] = keys[i];
+                }
+            });
+            wines.swap(sortedWines);
+            keys.swap(sortedKeys);
+        }
+    }
+
+    // Puts wines in address order, which is row order for the store's row views, so that a stable sort
+    // after it leaves equal keys in row order whatever order the index returned them in.
+    void orderByAddress(vector<Wine*>& wines, unsigned numThreads)
+    {
+        std::less<const Wine*> less;
+        if (std::is_sorted(wines.begin(), wines.end(), less))
+            return;
+        // Hash Table chains return their wines newest first.
+        if (std::is_sorted(wines.begin(), wines.end(), [&](const Wine* w1, const Wine* w2) { return less(w2, w1); })) {
+            std::reverse(wines.begin(), wines.end());
+            return;
+        }
+        auto bounds = std::minmax_element(wines.begin(), wines.end(), less);
+        uintptr_t low = (uintptr_t)*bounds.first;
+        uintptr_t range = ((uintptr_t)*bounds.second - low) / sizeof(Wine);
+        if (range > UINT32_MAX) {
+            std::sort(wines.begin(), wines.end(), less);
+            return;
+        }
+        vector<uint32_t> keys(wines.size());
+        for (size_t i = 0; i < wines.size(); i++)
+            keys[i] = (uint32_t)(((uintptr_t)wines[i] - low) / sizeof(Wine));
+        radixSort(wines, keys, (uint32_t)range, numThreads);
+    }
+}
 
 // Constructors for wine:
-Wine::Wine() : title(string()), country(string()), province(string()), variety(string()), rating(0), price(0) { }
-Wine::Wine(string _name, string _country, string _province, string _variety, char _rating, int _price) :
+Wine::Wine() : title(), country(), province(), variety(), rating(0), price(0) { }
+Wine::Wine(std::string_view _name, std::string_view _country, std::string_view _province, std::string_view _variety, char _rating, int _price) :
     title(_name), country(_country), province(_province), variety(_variety), rating(_rating), price(_price) {}
 
 
@@ -10,7 +104,7 @@ string Wine::toString(int titleWid, int countryProvWid, int varietyWid) const
 {
     std::stringstream wineStr;
     wineStr << std::left << std::setw(titleWid + 1) << title << "| ";
-    wineStr << std::setw(countryProvWid + 3) << (province + ", " + country) << "| ";
+    wineStr << std::setw(countryProvWid + 3) << (string(province) + ", " + string(country)) << "| ";
     wineStr << std::setw(varietyWid + 1) << variety << "| ";
     wineStr << std::setw(5) << getPriceStr() << "| ";
     wineStr << std::right << std::setw(2) << std::to_string(rating) << " points";
@@ -19,19 +113,35 @@ string Wine::toString(int titleWid, int countryProvWid, int varietyWid) const
 }
 
 string Wine::getTitle() const {
-    return title;
+    return string(title);
 }
 
 string Wine::getCountry() const {
-    return country;
+    return string(country);
 }
 
 string Wine::getProvince() const {
-    return province;
+    return string(province);
 }
 
 string Wine::getVariety() const {
-    return variety;
+    return string(variety);
+}
+
+std::string_view Wine::getValueView(Properties val) const
+{
+    switch (val) {
+    case Wine::Properties::VARIETY:
+        return variety;
+    case Wine::Properties::COUNTRY:
+        return country;
+    case Wine::Properties::TITLE:
+        return title;
+    case Wine::Properties::PROVINCE:
+        return province;
+    default:
+        return std::string_view();
+    }
 }
 
 string Wine::getPriceStr() const
@@ -48,22 +158,22 @@ int Wine::getPrice() const {
     return price;
 }
 
-void Wine::setTitle(string _title)
+void Wine::setTitle(std::string_view _title)
 {
     title = _title;
 }
 
-void Wine::setCountry(string _country)
+void Wine::setCountry(std::string_view _country)
 {
     country = _country;
 }
 
-void Wine::setProvince(string _province)
+void Wine::setProvince(std::string_view _province)
 {
     province = _province;
 }
 
-void Wine::setVariety(string _variety)
+void Wine::setVariety(std::string_view _variety)
 {
     variety = _variety;
 }
@@ -78,7 +188,7 @@ void Wine::setPrice(int _price)
     price = _price;
 }
 
-void Wine::setValue(string s, Properties val)
+void Wine::setValue(std::string_view s, Properties val)
 {
     switch (val) {
     case Wine::Properties::VARIETY:
@@ -93,6 +203,8 @@ void Wine::setValue(string s, Properties val)
     case Wine::Properties::PROVINCE:
         province = s;
         break;
+    default:
+        break;
     }
 }
 
@@ -128,14 +240,102 @@ bool Wine::ratingComp(const Wine* w1, const Wine* w2)
     return w1->rating > w2->rating;
 }
 
-void Wine::sortWine(vector<Wine*>& wines, Properties sortBy)
+void Wine::sortWine(vector<Wine*>& wines, Properties sortBy, unsigned numThreads)
+{
+    if (wines.size() < 2 || (sortBy != Wine::Properties::PRICE && sortBy != Wine::Properties::RATING))
+        return;
+    orderByAddress(wines, numThreads);
+    // Keys are offsets from the first wine in order, so that they need as few radix passes as possible.
+    vector<uint32_t> keys(wines.size());
+    uint32_t maxKey = 0;
+    switch (sortBy) {
+    case Wine::Properties::PRICE: {
+        int low = INT_MAX, high = INT_MIN;
+        for (const Wine* wine : wines) {
+            if (wine->price != 0) {
+                low = std::min(low, wine->price);
+                high = std::max(high, wine->price);
+            }
+        }
+        if (low > high)
+            return;
+        // N/A prices get the key after the highest price, so they sort last.
+        maxKey = (uint32_t)high - (uint32_t)low + 1;
+        for (size_t i = 0; i < wines.size(); i++)
+            keys[i] = wines[i]->price == 0 ? maxKey : (uint32_t)wines[i]->price - (uint32_t)low;
+        break;
+    }
+    case Wine::Properties::RATING: {
+        int low = INT_MAX, high = INT_MIN;
+        for (const Wine* wine : wines) {
+            low = std::min(low, (int)wine->rating);
+            high = std::max(high, (int)wine->rating);
+        }
+        // Highest rating first.
+        maxKey = (uint32_t)(high - low);
+        for (size_t i = 0; i < wines.size(); i++)
+            keys[i] = (uint32_t)(high - wines[i]->rating);
+        break;
+    }
+    default:
+        return;
+    }
+    radixSort(wines, keys, maxKey, numThreads);
+}
+
+void Wine::sortTopWine(vector<Wine*>& wines, Properties sortBy, size_t count, unsigned numThreads)
 {
+    if (count >= wines.size()) {
+        sortWine(wines, sortBy, numThreads);
+        return;
+    }
+    bool (*compare)(const Wine*, const Wine*);
     switch (sortBy) {
     case Wine::Properties::PRICE:
-        std::sort(wines.begin(), wines.end(), Wine::priceComp);
+        compare = Wine::priceComp;
         break;
     case Wine::Properties::RATING:
-        std::sort(wines.begin(), wines.end(), Wine::ratingComp);
+        compare = Wine::ratingComp;
         break;
+    default:
+        return;
+    }
+    if (count == 0)
+        return;
+    // Ties are broken by address, which puts them in row order like sortWine does, then by position.
+    typedef std::pair<Wine*, size_t> Candidate;
+    auto before = [compare](const Candidate& c1, const Candidate& c2) {
+        if (compare(c1.first, c2.first))
+            return true;
+        if (compare(c2.first, c1.first))
+            return false;
+        if (c1.first != c2.first)
+            return std::less<const Wine*>()(c1.first, c2.first);
+        return c1.second < c2.second;
+    };
+    // Max-heap of the best count wines seen so far; its top is the one the next better wine replaces.
+    std::priority_queue<Candidate, vector<Candidate>, decltype(before)> best(before);
+    for (size_t i = 0; i < wines.size(); i++) {
+        Candidate candidate(wines[i], i);
+        if (best.size() < count)
+            best.push(candidate);
+        else if (before(candidate, best.top())) {
+            best.pop();
+            best.push(candidate);
+        }
+    }
+
+    // Every wine ordered after the last one selected is one of the rest.
+    Candidate last = best.top();
+    vector<Wine*> ordered(wines.size());
+    for (size_t i = count; i > 0; i--) {
+        ordered[i - 1] = best.top().first;
+        best.pop();
+    }
+    size_t next = count;
+    for (size_t i = 0; i < wines.size(); i++) {
+        if (before(last, Candidate(wines[i], i)))
+            ordered[next++] = wines[i];
     }
+    wines.swap(ordered);
 }
\ No newline at end of file
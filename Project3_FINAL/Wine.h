@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <iomanip>
 #include <vector>
@@ -8,19 +9,21 @@
 using std::string;
 using std::vector;
 
+// Wine does not own its strings: each one is a view into storage that must outlive the Wine
+// (the mapped CSV file or the arena it was unescaped into, or the caller's search key).
 class Wine {
 private:
     // Wine Properties:
-    string title;
-    string country;
-    string province;
-    string variety;
+    std::string_view title;
+    std::string_view country;
+    std::string_view province;
+    std::string_view variety;
     char rating;
     int price;
 public:
     enum class Properties { NONE, VARIETY, COUNTRY, TITLE, PROVINCE, RATING, PRICE };
 
-    // Used by the RedBlackTree class for comparing keys.
+    // Three-way comparisons of each key, in the order RedBlackTree keeps them.
     static int titleComp(const Wine* w1, const Wine* w2);
     static int countryComp(const Wine* w1, const Wine* w2);
     static int provinceComp(const Wine* w1, const Wine* w2);
@@ -30,12 +33,17 @@ public:
     static bool priceComp(const Wine* w1, const Wine* w2);
     static bool ratingComp(const Wine* w1, const Wine* w2);
 
-    // Used to order search results by either rating or price.
-    static void sortWine(vector<Wine*>& wines, Properties sortBy);
+    // Used to order search results by either rating or price, in the order of ratingComp and priceComp, with ties
+    // in row order (the address order of the store's row views). Radix sort on the small integer keys; large inputs
+    // are split over up to numThreads threads.
+    static void sortWine(vector<Wine*>& wines, Properties sortBy, unsigned numThreads = 1);
+    // Moves the count best wines by sortBy to the front, in the order sortWine would put them; the rest are left
+    // unordered. Selects them with a heap in O(n log count) rather than sorting everything.
+    static void sortTopWine(vector<Wine*>& wines, Properties sortBy, size_t count, unsigned numThreads = 1);
 
     // Wine constructors:
     Wine();
-    Wine(std::string _name, string _country, string _province, string _variety, char _rating, int _price);
+    Wine(std::string_view _name, std::string_view _country, std::string_view _province, std::string_view _variety, char _rating, int _price);
 
     // Accessor functions:
     string getTitle() const;
@@ -43,6 +51,12 @@ public:
     string getProvince() const;
     string getVariety() const;
     string getPriceStr() const;
+    // Non-owning accessors; these never copy the string. Defined here so that the index templates inline them.
+    std::string_view getTitleView() const { return title; }
+    std::string_view getCountryView() const { return country; }
+    std::string_view getProvinceView() const { return province; }
+    std::string_view getVarietyView() const { return variety; }
+    std::string_view getValueView(Properties val) const;
     int getRating() const;
     int getPrice() const;
 
@@ -50,11 +64,11 @@ public:
     string toString(int titleWid, int CocountryProvWid, int varietyWid) const;
 
     // Manipulator functions:
-    void setTitle(string _name);
-    void setCountry(string _country);
-    void setProvince(string _province);
-    void setVariety(string _variety);
+    void setTitle(std::string_view _name);
+    void setCountry(std::string_view _country);
+    void setProvince(std::string_view _province);
+    void setVariety(std::string_view _variety);
     void setRating(int _rating);
     void setPrice(int _price);
-    void setValue(string s, Properties val);
+    void setValue(std::string_view s, Properties val);
 };
\ No newline at end of file
@@ -0,0 +1,504 @@
+#include "WineStore.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include "HyperLogLog.h"
+#include "MappedFile.h"
+#include "Snapshot.h"
+
+namespace {
+	// Maps code of from onto to's code for the same value, interning it on first use (codeMap caches the
+	// result, with -1 for not yet mapped). Returns false if to is full.
+	bool remap(WineStore::Dictionary& to, const WineStore::Dictionary& from, vector<int32_t>& codeMap,
+		WineStore::Code code, WineStore::Code& mapped)
+	{
+		if (codeMap[code] < 0) {
+			if (!to.intern(from.value(code), mapped))
+				return false;
+			codeMap[code] = mapped;
+		}
+		mapped = (WineStore::Code)codeMap[code];
+		return true;
+	}
+}
+
+bool WineStore::Dictionary::intern(std::string_view value, Code& code)
+{
+	if (!sortedCodes.empty())
+		own();
+	auto found = codes.find(value);
+	if (found != codes.end()) {
+		code = found->second;
+		return true;
+	}
+	if (values.size() == MAX_SIZE)
+		return false;
+	code = (Code)values.size();
+	std::string_view stored = storage.copyString(value);
+	values.push_back(stored);
+	codes.emplace(stored, code);
+	return true;
+}
+
+bool WineStore::Dictionary::find(std::string_view value, Code& code) const
+{
+	if (!sortedCodes.empty()) {
+		const Code* found = std::lower_bound(sortedCodes.begin(), sortedCodes.end(), value,
+			[&](Code stored, std::string_view key) { return values[stored] < key; });
+		if (found == sortedCodes.end() || values[*found] != value)
+			return false;
+		code = *found;
+		return true;
+	}
+	auto found = codes.find(value);
+	if (found == codes.end())
+		return false;
+	code = found->second;
+	return true;
+}
+
+std::string_view WineStore::Dictionary::value(Code code) const
+{
+	return values[code];
+}
+
+size_t WineStore::Dictionary::size() const
+{
+	return values.size();
+}
+
+size_t WineStore::Dictionary::memoryUsage() const
+{
+	// Approximates each hash map entry as the key, value and one bucket pointer.
+	return storage.capacity() + values.capacity() * sizeof(std::string_view) +
+		codes.size() * (sizeof(std::string_view) + sizeof(Code) + 2 * sizeof(void*)) +
+		mappedHeap.capacity() + sortedCodes.capacity() * sizeof(Code);
+}
+
+void WineStore::Dictionary::clear()
+{
+	codes.clear();
+	values.clear();
+	storage.clear();
+	mappedHeap.clear();
+	sortedCodes.clear();
+}
+
+void WineStore::Dictionary::own()
+{
+	// mappedHeap is kept, since row views built earlier may still point into it.
+	for (size_t code = 0; code < values.size(); code++) {
+		values[code] = storage.copyString(values[code]);
+		codes.emplace(values[code], (Code)code);
+	}
+	sortedCodes.clear();
+}
+
+void WineStore::Dictionary::writeSnapshot(SnapshotWriter& writer) const
+{
+	vector<uint64_t> offsets(1, 0);
+	std::string heap;
+	for (std::string_view stored : values) {
+		heap.append(stored.data(), stored.size());
+		offsets.push_back(heap.size());
+	}
+	vector<Code> sorted(values.size());
+	for (size_t code = 0; code < sorted.size(); code++)
+		sorted[code] = (Code)code;
+	std::sort(sorted.begin(), sorted.end(), [&](Code code1, Code code2) { return values[code1] < values[code2]; });
+	writer.writeArray(offsets);
+	writer.writeArray(heap.data(), heap.size());
+	writer.writeArray(sorted);
+}
+
+bool WineStore::Dictionary::readSnapshot(SnapshotReader& reader)
+{
+	clear();
+	MappedArray<uint64_t> offsets;
+	if (!reader.viewArray(offsets) || offsets.empty() || offsets.size() - 1 > MAX_SIZE || offsets[0] != 0 ||
+		!reader.viewArray(mappedHeap) || !reader.viewArray(sortedCodes) || sortedCodes.size() != offsets.size() - 1) {
+		clear();
+		return false;
+	}
+	values.resize(sortedCodes.size());
+	for (size_t code = 0; code < values.size(); code++) {
+		if (offsets[code] > offsets[code + 1] || offsets[code + 1] > mappedHeap.size()) {
+			clear();
+			return false;
+		}
+		values[code] = std::string_view(mappedHeap.data() + offsets[code], (size_t)(offsets[code + 1] - offsets[code]));
+	}
+	// Strictly increasing values make sortedCodes a permutation and rule out duplicates, which find() can't tell apart.
+	for (size_t i = 0; i < sortedCodes.size(); i++) {
+		if (sortedCodes[i] >= values.size() || (i > 0 && !(values[sortedCodes[i - 1]] < values[sortedCodes[i]]))) {
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+WineStore::WineStore() : viewsBuilt(false), skippedRows(0)
+{
+	titleOffsets.push_back(0);
+	titleBlockBases.push_back(0);
+}
+
+bool WineStore::loadCSV(const std::string& path, unsigned numThreads, size_t& fileSize)
+{
+	clear();
+	fileSize = 0;
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+	fileSize = file.size();
+
+	// Skips the header row.
+	const char* dataStart = static_cast<const char*>(memchr(file.begin(), '\n', file.size()));
+	dataStart = dataStart == nullptr ? file.end() : dataStart + 1;
+
+	if (numThreads <= 1) {
+		readRange(dataStart, file.end(), *this, false);
+	}
+	else {
+		// Each worker parses its own newline aligned byte range into a thread local store.
+		vector<std::pair<const char*, const char*>> ranges = CSVReader::partition(dataStart, file.end(), numThreads);
+		vector<WineStore> rangeStores(ranges.size());
+		vector<std::thread> workers;
+		for (size_t i = 0; i < ranges.size(); i++) {
+			workers.emplace_back(readRange, ranges[i].first, ranges[i].second, std::ref(rangeStores[i]), true);
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+
+		// Merges the stores back in file order.
+		size_t totalRows = 0;
+		for (const WineStore& store : rangeStores)
+			totalRows += store.size() + store.rejectedRows.size();
+		reserve(totalRows);
+		for (WineStore& store : rangeStores) {
+			appendRows(store);
+			store.clear();
+		}
+	}
+	// The store holds its own copy of every string, so the file is unmapped on return.
+	finalize();
+	return true;
+}
+
+void WineStore::readRange(const char* begin, const char* end, WineStore& store, bool deferRejected)
+{
+	// The line count bounds the row count, so the columns never reallocate while loading.
+	store.reserve(std::count(begin, end, '\n') + 1);
+	Arena unescapedFields;
+	CSVReader reader(begin, end, unescapedFields);
+	WineRecord record;
+	while (reader.next(record)) {
+		if (store.append(record))
+			continue;
+		if (!deferRejected) {
+			store.skippedRows++;
+			continue;
+		}
+		// The merged store may still have room for the row, so it is kept (with its own copy of every field).
+		WineRecord rejected{ store.rejectedStrings.copyString(record.title), store.rejectedStrings.copyString(record.country),
+			store.rejectedStrings.copyString(record.variety), store.rejectedStrings.copyString(record.province),
+			record.price, record.points };
+		store.rejectedRows.emplace_back(store.size(), rejected);
+	}
+}
+
+size_t WineStore::getSkippedRows() const
+{
+	return skippedRows;
+}
+
+void WineStore::writeSnapshot(SnapshotWriter& writer) const
+{
+	writer.writeU64(skippedRows);
+	countryDictionary.writeSnapshot(writer);
+	provinceDictionary.writeSnapshot(writer);
+	varietyDictionary.writeSnapshot(writer);
+	writer.writeArray(titleHeap);
+	writer.writeArray(titleOffsets);
+	writer.writeArray(titleBlockBases);
+	writer.writeArray(countries);
+	writer.writeArray(provinces);
+	writer.writeArray(varieties);
+	writer.writeArray(ratings);
+	writer.writeArray(prices);
+}
+
+bool WineStore::readSnapshot(SnapshotReader& reader)
+{
+	clear();
+	uint64_t skipped;
+	bool valid = reader.readU64(skipped) && countryDictionary.readSnapshot(reader) && provinceDictionary.readSnapshot(reader) &&
+		varietyDictionary.readSnapshot(reader) && reader.viewArray(titleHeap) && reader.viewArray(titleOffsets) &&
+		reader.viewArray(titleBlockBases) && reader.viewArray(countries) && reader.viewArray(provinces) && reader.viewArray(varieties) &&
+		reader.viewArray(ratings) && reader.viewArray(prices);
+
+	// Every column has to cover the same rows, and every code and title has to be in range.
+	size_t numRows = prices.size();
+	valid = valid && titleOffsets.size() == numRows + 1 && titleBlockBases.size() == (numRows >> TITLE_BLOCK_BITS) + 1 &&
+		countries.size() == numRows && provinces.size() == numRows && varieties.size() == numRows && ratings.size() == numRows &&
+		titleOffset(0) == 0 && titleOffset(numRows) == titleHeap.size();
+	for (RowId id = 0; valid && id < numRows; id++) {
+		valid = titleOffset(id) <= titleOffset(id + 1) && countries[id] < countryDictionary.size() &&
+			provinces[id] < provinceDictionary.size() && varieties[id] < varietyDictionary.size();
+	}
+	if (!valid) {
+		clear();
+		return false;
+	}
+	skippedRows = (size_t)skipped;
+	finalize();
+	return true;
+}
+
+uint64_t WineStore::titleOffset(size_t i) const
+{
+	return titleBlockBases[i >> TITLE_BLOCK_BITS] + titleOffsets[i];
+}
+
+bool WineStore::fitsTitle(size_t length) const
+{
+	// The row's end offset starts a new block (at offset 0) when the row is the last of its block.
+	if ((titleOffsets.size() & (TITLE_BLOCK_SIZE - 1)) == 0)
+		return true;
+	return titleHeap.size() + length - titleBlockBases.back() <= UINT32_MAX;
+}
+
+void WineStore::appendRow(std::string_view title, Code country, Code province, Code variety, char rating, int price)
+{
+	titleHeap.append(title.data(), title.size());
+	if ((titleOffsets.size() & (TITLE_BLOCK_SIZE - 1)) == 0)
+		titleBlockBases.push_back(titleHeap.size());
+	titleOffsets.push_back((uint32_t)(titleHeap.size() - titleBlockBases.back()));
+	countries.push_back(country);
+	provinces.push_back(province);
+	varieties.push_back(variety);
+	ratings.push_back(rating);
+	prices.push_back(price);
+}
+
+bool WineStore::append(const WineRecord& record)
+{
+	Code country, province, variety;
+	if (!fitsTitle(record.title.size()) || !countryDictionary.intern(record.country, country) ||
+		!provinceDictionary.intern(record.province, province) || !varietyDictionary.intern(record.variety, variety))
+		return false;
+	appendRow(record.title, country, province, variety, (char)record.points, record.price);
+	return true;
+}
+
+void WineStore::appendRows(const WineStore& other)
+{
+	skippedRows += other.skippedRows;
+	// Maps other's codes onto this store's codes once per distinct value, in the same order append() interns them.
+	vector<int32_t> countryMap(other.countryDictionary.size(), -1);
+	vector<int32_t> provinceMap(other.provinceDictionary.size(), -1);
+	vector<int32_t> varietyMap(other.varietyDictionary.size(), -1);
+	size_t nextRejected = 0;
+	auto appendRejected = [&](size_t position) {
+		for (; nextRejected < other.rejectedRows.size() && other.rejectedRows[nextRejected].first == position; nextRejected++) {
+			if (!append(other.rejectedRows[nextRejected].second))
+				skippedRows++;
+		}
+	};
+	for (RowId id = 0; id < other.size(); id++) {
+		appendRejected(id);
+		std::string_view title = other.getTitle(id);
+		Code country, province, variety;
+		if (!fitsTitle(title.size()) || !remap(countryDictionary, other.countryDictionary, countryMap, other.countries[id], country) ||
+			!remap(provinceDictionary, other.provinceDictionary, provinceMap, other.provinces[id], province) ||
+			!remap(varietyDictionary, other.varietyDictionary, varietyMap, other.varieties[id], variety)) {
+			skippedRows++;
+			continue;
+		}
+		appendRow(title, country, province, variety, other.ratings[id], other.prices[id]);
+	}
+	appendRejected(other.size());
+}
+
+void WineStore::reserve(size_t numRows)
+{
+	titleOffsets.reserve(numRows + 1);
+	titleBlockBases.reserve((numRows >> TITLE_BLOCK_BITS) + 1);
+	countries.reserve(numRows);
+	provinces.reserve(numRows);
+	varieties.reserve(numRows);
+	ratings.reserve(numRows);
+	prices.reserve(numRows);
+}
+
+void WineStore::finalize()
+{
+	titleHeap.shrink_to_fit();
+	// Views of the previous rows would point into the heap before it moved.
+	rows.clear();
+	rows.shrink_to_fit();
+	viewsBuilt.store(false);
+}
+
+void WineStore::buildViews()
+{
+	if (viewsBuilt.load(std::memory_order_acquire))
+		return;
+	std::lock_guard<std::mutex> lock(viewsLock);
+	if (viewsBuilt.load(std::memory_order_relaxed))
+		return;
+	rows.reserve(size());
+	for (RowId id = 0; id < size(); id++) {
+		rows.emplace_back(getTitle(id), getCountry(id), getProvince(id), getVariety(id), ratings[id], prices[id]);
+	}
+	viewsBuilt.store(true, std::memory_order_release);
+}
+
+void WineStore::clear()
+{
+	skippedRows = 0;
+	rows.clear();
+	rows.shrink_to_fit();
+	viewsBuilt.store(false);
+	rejectedRows.clear();
+	rejectedStrings.clear();
+	titleHeap.clear();
+	titleOffsets.assign(1, 0);
+	titleBlockBases.assign(1, 0);
+	countries.clear();
+	provinces.clear();
+	varieties.clear();
+	ratings.clear();
+	prices.clear();
+	countryDictionary.clear();
+	provinceDictionary.clear();
+	varietyDictionary.clear();
+}
+
+size_t WineStore::size() const
+{
+	return prices.size();
+}
+
+bool WineStore::empty() const
+{
+	return prices.empty();
+}
+
+Wine* WineStore::operator[](RowId id)
+{
+	buildViews();
+	return &rows[id];
+}
+
+vector<Wine*> WineStore::getWines()
+{
+	buildViews();
+	vector<Wine*> wines;
+	wines.reserve(rows.size());
+	for (Wine& wine : rows)
+		wines.push_back(&wine);
+	return wines;
+}
+
+WineStore::RowId WineStore::rowId(const Wine* wine) const
+{
+	return (RowId)(wine - rows.data());
+}
+
+std::string_view WineStore::getTitle(RowId id) const
+{
+	uint64_t start = titleOffset(id);
+	return std::string_view(titleHeap.data() + start, (size_t)(titleOffset(id + 1) - start));
+}
+
+std::string_view WineStore::getCountry(RowId id) const
+{
+	return countryDictionary.value(countries[id]);
+}
+
+std::string_view WineStore::getProvince(RowId id) const
+{
+	return provinceDictionary.value(provinces[id]);
+}
+
+std::string_view WineStore::getVariety(RowId id) const
+{
+	return varietyDictionary.value(varieties[id]);
+}
+
+int WineStore::getRating(RowId id) const
+{
+	return ratings[id];
+}
+
+int WineStore::getPrice(RowId id) const
+{
+	return prices[id];
+}
+
+const MappedArray<WineStore::Code>& WineStore::getCountryCodes() const
+{
+	return countries;
+}
+
+const MappedArray<WineStore::Code>& WineStore::getProvinceCodes() const
+{
+	return provinces;
+}
+
+const MappedArray<WineStore::Code>& WineStore::getVarietyCodes() const
+{
+	return varieties;
+}
+
+const MappedArray<char>& WineStore::getRatings() const
+{
+	return ratings;
+}
+
+const MappedArray<int>& WineStore::getPrices() const
+{
+	return prices;
+}
+
+const WineStore::Dictionary* WineStore::getDictionary(Wine::Properties property) const
+{
+	switch (property) {
+	case Wine::Properties::COUNTRY:
+		return &countryDictionary;
+	case Wine::Properties::PROVINCE:
+		return &provinceDictionary;
+	case Wine::Properties::VARIETY:
+		return &varietyDictionary;
+	default:
+		return nullptr;
+	}
+}
+
+size_t WineStore::estimateDistinct(Wine::Properties property) const
+{
+	const Dictionary* dictionary = getDictionary(property);
+	if (dictionary != nullptr)
+		return dictionary->size();
+
+	HyperLogLog counter;
+	for (RowId id = 0; id < size(); id++)
+		counter.add(getTitle(id));
+	return counter.estimate();
+}
+
+size_t WineStore::columnMemoryUsage() const
+{
+	return titleHeap.capacity() + titleOffsets.capacity() * sizeof(uint32_t) + titleBlockBases.capacity() * sizeof(uint64_t) +
+		(countries.capacity() + provinces.capacity() + varieties.capacity()) * sizeof(Code) +
+		ratings.capacity() * sizeof(char) + prices.capacity() * sizeof(int) +
+		countryDictionary.memoryUsage() + provinceDictionary.memoryUsage() + varietyDictionary.memoryUsage();
+}
+
+size_t WineStore::memoryUsage() const
+{
+	return columnMemoryUsage() + std::max(rows.capacity(), size()) * sizeof(Wine);
+}
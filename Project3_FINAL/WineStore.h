@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+#include "CSVReader.h"
+#include "MappedArray.h"
+#include "Wine.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Columnar storage for the wine data set. Rows are addressed by a 32-bit row id.
+// Country, province and variety are dictionary encoded as 16-bit codes and titles share one contiguous heap.
+class WineStore {
+public:
+	typedef uint32_t RowId;
+	typedef uint16_t Code;
+
+	// Interns the distinct values of one low cardinality column.
+	class Dictionary {
+	private:
+		Arena storage;
+		vector<std::string_view> values;
+		std::unordered_map<std::string_view, Code> codes;
+		// Set by readSnapshot(): the values' heap, viewed in place, and the codes in value order, which find()
+		// binary searches instead of hashing. Both are empty for a dictionary built by intern().
+		MappedArray<char> mappedHeap;
+		MappedArray<Code> sortedCodes;
+
+		// Copies the values read from a snapshot into storage and codes, so intern() can add to them.
+		void own();
+	public:
+		static constexpr size_t MAX_SIZE = 65536;
+
+		// Returns the code for value, adding it if needed. Returns false if the dictionary is full.
+		bool intern(std::string_view value, Code& code);
+		// Returns false if value has never been interned.
+		bool find(std::string_view value, Code& code) const;
+
+		std::string_view value(Code code) const;
+		size_t size() const;
+		size_t memoryUsage() const;
+		void clear();
+
+		// Writes the values in code order (as offsets into one heap) and the codes in value order.
+		void writeSnapshot(SnapshotWriter& writer) const;
+		bool readSnapshot(SnapshotReader& reader);
+	};
+private:
+	Dictionary countryDictionary;
+	Dictionary provinceDictionary;
+	Dictionary varietyDictionary;
+
+	// Titles are stored back to back; row i's title is titleHeap[titleOffset(i), titleOffset(i + 1)).
+	// Offsets are 32 bits relative to the base of their block of TITLE_BLOCK_SIZE rows, so the heap can pass 4 GiB.
+	static constexpr size_t TITLE_BLOCK_BITS = 16;
+	static constexpr size_t TITLE_BLOCK_SIZE = (size_t)1 << TITLE_BLOCK_BITS;
+	MappedArray<char> titleHeap;
+	MappedArray<uint32_t> titleOffsets;
+	MappedArray<uint64_t> titleBlockBases;
+
+	// One column per property.
+	MappedArray<Code> countries;
+	MappedArray<Code> provinces;
+	MappedArray<Code> varieties;
+	MappedArray<char> ratings;
+	MappedArray<int> prices;
+
+	// Row views handed out to the Wine based indexes. Built on first use rather than by finalize(),
+	// since loads that are only queried through the columns never need them.
+	vector<Wine> rows;
+	std::atomic<bool> viewsBuilt;
+	std::mutex viewsLock;
+
+	// Rows dropped by the last load because a dictionary (or a title block) was full.
+	size_t skippedRows;
+
+	// Rows a thread local store couldn't encode, with the number of rows it held before each. The merge
+	// appends them again at that position, so that the same rows are skipped however many threads parse.
+	vector<std::pair<size_t, WineRecord>> rejectedRows;
+	Arena rejectedStrings;
+
+	uint64_t titleOffset(size_t i) const;
+	// Returns false if a title of length bytes would not fit in the current title block.
+	bool fitsTitle(size_t length) const;
+	// Adds a row whose values are already encoded and fit.
+	void appendRow(std::string_view title, Code country, Code province, Code variety, char rating, int price);
+	// Builds rows if it hasn't been yet. Safe to call from several threads.
+	void buildViews();
+
+	// Parses the whole rows in [begin, end) into store. With deferRejected, rows store can't hold are
+	// kept in rejectedRows instead of being counted as skipped.
+	static void readRange(const char* begin, const char* end, WineStore& store, bool deferRejected);
+public:
+	WineStore();
+
+	// Replaces the contents with the rows of the CSV file at path (skipping its header) and finalizes.
+	// Parses on numThreads threads. Returns false if the file can't be opened; fileSize receives its size.
+	bool loadCSV(const std::string& path, unsigned numThreads, size_t& fileSize);
+	size_t getSkippedRows() const;
+
+	// Writes every column and string heap. readSnapshot() replaces the contents with views of what was written,
+	// read in place from the reader's buffer, and finalizes; it returns false (leaving the store empty) if the
+	// data is malformed.
+	void writeSnapshot(SnapshotWriter& writer) const;
+	bool readSnapshot(SnapshotReader& reader);
+
+	// Adds a row. Returns false (and adds nothing) if one of the dictionaries is full.
+	bool append(const WineRecord& record);
+	// Adds every row of other (and its rejected rows) in order, re-encoding its dictionary codes.
+	// Rows that don't fit are skipped one by one, exactly as append(const WineRecord&) would.
+	void appendRows(const WineStore& other);
+	void reserve(size_t numRows);
+
+	// Must be called after the last append. The Wine views returned by operator[] are built on first use.
+	void finalize();
+	void clear();
+
+	size_t size() const;
+	bool empty() const;
+	Wine* operator[](RowId id);
+	// Pointers to every row view, in row id order.
+	vector<Wine*> getWines();
+	// Row id of a Wine returned by operator[].
+	RowId rowId(const Wine* wine) const;
+
+	// Column accessors:
+	std::string_view getTitle(RowId id) const;
+	std::string_view getCountry(RowId id) const;
+	std::string_view getProvince(RowId id) const;
+	std::string_view getVariety(RowId id) const;
+	int getRating(RowId id) const;
+	int getPrice(RowId id) const;
+	const MappedArray<Code>& getCountryCodes() const;
+	const MappedArray<Code>& getProvinceCodes() const;
+	const MappedArray<Code>& getVarietyCodes() const;
+	const MappedArray<char>& getRatings() const;
+	const MappedArray<int>& getPrices() const;
+	// Returns nullptr for properties that aren't dictionary encoded.
+	const Dictionary* getDictionary(Wine::Properties property) const;
+
+	// Number of distinct values of property. Exact for the dictionary encoded columns,
+	// a HyperLogLog estimate for titles.
+	size_t estimateDistinct(Wine::Properties property) const;
+
+	// Bytes held by the columns and dictionaries, including the parts viewed in a mapped snapshot.
+	size_t columnMemoryUsage() const;
+	// columnMemoryUsage() plus the row views. Those are counted even before they are built, since the first
+	// search through a Wine based index builds them, so this is what the store holds once it is queried.
+	size_t memoryUsage() const;
+};
@@ -2,51 +2,93 @@
 #include <tuple>
 #include <chrono>
 #include <iostream>
+#include <thread>
 #include "Wine.h"
-#include "HashTable.h"
-#include "RedBlackTree.h"
+#include "IndexManager.h"
+#include "WineStore.h"
+#include "Batch.h"
+#include "Benchmark.h"
+#include "DatasetGenerator.h"
+#include "QueryEngine.h"
+#include "Snapshot.h"
 
 using namespace std;
 
-vector<Wine*> wineCellar; // Global vector that holds pointers to dynaimically allocated wine data.
-void readWineCSV(); // Reads wine data into wineCellar vector.
-tuple <Wine::Properties, bool, bool > getUserSpecifications(); // Gets user input and returns specification for preformSearch function.
-void preformSearch(tuple<Wine::Properties, bool, bool> userSpecifications);
-void printResults(vector<Wine*> RBTreeResults);
-void deleteWines(); // Deallocates pointers stored in wineCellar and clear out wine cellar.
-void loadbar(float percentage); // Used to show progress in Red-Black Tree and Hash Table construction.
+WineStore wineCellar; // Global columnar store that holds the wine data, indexed by row id.
+IndexManager wineIndexes(wineCellar); // Indexes over wineCellar, built once and reused across searches.
+bool showIndexStats = false; // Set by --index-stats: print the health of every Red-Black Tree and Hash Table searched.
+// Reads wine data into wineCellar vector, parsing on numThreads threads.
+// With useSnapshot, maps the data and array indexes from the CSV's snapshot instead when it is up to date, and writes a new one when it isn't.
+void readWineCSV(const string& csvPath, unsigned numThreads = 1, bool useSnapshot = false);
+// Gets user input and returns specification for preformSearch function. The last flag asks for a search by several
+// properties through the query engine, in which case the property and data structures are unused.
+tuple <Wine::Properties, bool, bool, bool, bool, bool > getUserSpecifications();
+void preformSearch(tuple<Wine::Properties, bool, bool, bool, bool, bool> userSpecifications);
+// Kinds of search offered by the menu. Only the ordered structures (the trees) can answer PREFIX and RANGE.
+enum class QueryType { EXACT, PREFIX, RANGE };
+QueryType getQueryType(); // Asks which kind of search to run on the trees.
+// Searches one index (building it first if needed) and reports construction and search time separately.
+// RANGE searches every key in [searchKey, highKey]; highKey is ignored otherwise.
+void searchIndex(IndexManager::Structure structure, const string& name, Wine::Properties searchBy, QueryType queryType,
+    const string& searchKey, const string& highKey, vector<Wine*>& results);
+// Asks for a condition on every property (each optional) and runs their conjunction through the query engine,
+// printing its EXPLAIN plan.
+void searchConjunction();
+// Reads an integer bound; an empty line keeps fallback.
+int readBound(const string& prompt, int fallback);
+// Sorts and prints results in place. For an exact search, searchBy and searchKey let the top results be read from a pre-ordered index.
+void printResults(vector<Wine*>& results, Wine::Properties searchBy = Wine::Properties::NONE, string_view searchKey = "");
+void deleteWines(); // Releases the wine data and clears out wine cellar.
+void loadbar(float percentage); // Used to show progress in index construction.
 bool yesOrNoReq(string outputReq); // Get user response for (y/n) questions.
 
-void readWineCSV() {
+void readWineCSV(const string& csvPath, unsigned numThreads, bool useSnapshot) {
     if (!wineCellar.empty()) deleteWines();
 
-    string title;
-    string country;
-    string variety;
-    string province;
-    string price;
-    string points;
-
-    ifstream file("winemag-data-130k-v2.csv");
-    if (file.is_open()) {
-        string line;
-        getline(file, line);
-        while (getline(file, line)) {
-            istringstream stream(line);
-            getline(stream, title, ',');
-            getline(stream, country, ',');
-            getline(stream, variety, ',');
-            getline(stream, province, ',');
-            getline(stream, price, ',');
-            getline(stream, points, ',');
-
-            wineCellar.push_back(new Wine(title, country, province, variety, (char)stoi(points), stoi(price)));
-        }
-        file.close();
+    const string snapshotPath = Snapshot::pathFor(csvPath);
+    auto loadStart = chrono::high_resolution_clock::now();
+    if (useSnapshot && Snapshot::load(snapshotPath, csvPath, wineCellar, wineIndexes)) {
+        auto loadStop = chrono::high_resolution_clock::now();
+        cout << "Loaded " << wineCellar.size() << " wines and their indexes from " << snapshotPath << " in "
+            << fixed << setprecision(1) << chrono::duration<double>(loadStop - loadStart).count() * 1000.0 << " ms." << endl;
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6) << endl;
+        return;
+    }
+
+    size_t fileSize = 0;
+    if (!wineCellar.loadCSV(csvPath, numThreads, fileSize)) {
+        cout << "Could not open " << csvPath << endl;
+        return;
+    }
+    if (wineCellar.getSkippedRows() > 0)
+        cout << "Too many distinct countries, provinces or varieties; " << wineCellar.getSkippedRows() << " wines were skipped." << endl;
+
+    wineIndexes.invalidate();
+    auto loadStop = chrono::high_resolution_clock::now();
+    double seconds = chrono::duration<double>(loadStop - loadStart).count();
+    double megabytes = fileSize / (1024.0 * 1024.0);
+    cout << "Loaded " << wineCellar.size() << " wines (" << fixed << setprecision(1) << megabytes << " MB) in "
+        << seconds * 1000.0 << " ms (" << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s), using "
+        << (wineCellar.empty() ? 0.0 : (double)wineCellar.memoryUsage() / wineCellar.size()) << " bytes per wine ("
+        << (wineCellar.empty() ? 0.0 : (double)wineCellar.columnMemoryUsage() / wineCellar.size())
+        << " in columns, the rest in the row views the first search builds)." << endl;
+
+    if (useSnapshot) {
+        // Builds the posting, rating and price indexes once, so the next start maps them instead.
+        auto saveStart = chrono::high_resolution_clock::now();
+        bool saved = Snapshot::save(snapshotPath, csvPath, wineCellar, wineIndexes);
+        auto saveStop = chrono::high_resolution_clock::now();
+        if (saved)
+            cout << "Wrote " << snapshotPath << " in " << chrono::duration<double>(saveStop - saveStart).count() * 1000.0 << " ms." << endl;
+        else
+            cout << "Could not write " << snapshotPath << endl;
     }
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6) << endl;
 }
 
-tuple<Wine::Properties, bool, bool> getUserSpecifications() {
+tuple<Wine::Properties, bool, bool, bool, bool, bool> getUserSpecifications() {
     int input = 0;
     // Keeps track of what info is being asked of the user. 
     bool gettingSearch = true;
@@ -56,6 +98,9 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
     Wine::Properties searchBy = Wine::Properties::NONE;
     bool useRBTree = false;
     bool useHashTable = false;
+    bool useBPlusTree = false;
+    bool useFlatHashTable = false;
+    bool useQueryEngine = false;
 
     while (gettingSearch) {
         cout << "Menu Options" << endl;
@@ -64,7 +109,8 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
         cout << "2. Search by country" << endl;
         cout << "3. Search by title" << endl;
         cout << "4. Search by province" << endl;
-        cout << "5. Exit" << endl;
+        cout << "5. Search by several properties (incl. rating and price ranges)" << endl;
+        cout << "6. Exit" << endl;
         cin >> input;
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cout << endl;
@@ -103,6 +149,12 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
             gettingDataStruct = true;
             break;
         case 5:
+            // The query engine picks the indexes itself, so there is no data structure to pick.
+            useQueryEngine = true;
+            cout << "Search by Several Properties.\n" << endl;
+            gettingSearch = false;
+            break;
+        case 6:
             gettingSearch = false;
             gettingDataStruct = false;
             continue;
@@ -114,11 +166,16 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
         while (gettingDataStruct) {
             useRBTree = false;
             useHashTable = false;
+            useBPlusTree = false;
+            useFlatHashTable = false;
             cout << "Which Data Structure To Test?" << endl;
             cout << "1. Use Red-Black Tree" << endl;
             cout << "2. Use Hash Table" << endl;
             cout << "3. Use Both Data Structures" << endl;
-            cout << "4. Go Back" << endl;
+            cout << "4. Use B+ Tree" << endl;
+            cout << "5. Use All Three Data Structures" << endl;
+            cout << "6. Use Flat Hash Table" << endl;
+            cout << "7. Go Back" << endl;
             cin >> input;
             cin.ignore(numeric_limits<streamsize>::max(), '\n');
             cout << endl;
@@ -146,6 +203,20 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
                 gettingDataStruct = false;
                 break;
             case 4:
+                useBPlusTree = true;
+                gettingDataStruct = false;
+                break;
+            case 5:
+                useRBTree = true;
+                useHashTable = true;
+                useBPlusTree = true;
+                gettingDataStruct = false;
+                break;
+            case 6:
+                useFlatHashTable = true;
+                gettingDataStruct = false;
+                break;
+            case 7:
                 gettingSearch = true;
                 gettingDataStruct = false;
                 continue;
@@ -156,124 +227,264 @@ tuple<Wine::Properties, bool, bool> getUserSpecifications() {
         }
     }
     // Returned tuple is read by perform search function.
-    return make_tuple(searchBy, useRBTree, useHashTable);  .
+    return make_tuple(searchBy, useRBTree, useHashTable, useBPlusTree, useFlatHashTable, useQueryEngine);
 }
 
 // Receives inputs from getUserSpecification function.
-void preformSearch(tuple<Wine::Properties, bool, bool> userSpecifications) {
+void preformSearch(tuple<Wine::Properties, bool, bool, bool, bool, bool> userSpecifications) {
     Wine::Properties searchBy;
     bool useRBTree;
     bool useHashTable;
-    tie(searchBy, useRBTree, useHashTable) = userSpecifications;
-    string searchKey;
+    bool useBPlusTree;
+    bool useFlatHashTable;
+    bool useQueryEngine;
+    tie(searchBy, useRBTree, useHashTable, useBPlusTree, useFlatHashTable, useQueryEngine) = userSpecifications;
+    string searchKey, highKey;
+    if (useQueryEngine) {
+        searchConjunction();
+        return;
+    }
+    if (searchBy == Wine::Properties::NONE)
+        return;
 
+    QueryType queryType = useRBTree || useBPlusTree ? getQueryType() : QueryType::EXACT;
+    string propertyName;
     switch (searchBy) {
-    case Wine::Properties::NONE:
-        return;
     case Wine::Properties::VARIETY:
-        cout << "Enter Wine Variety to Search: ";
+        propertyName = "Wine Variety";
         break;
     case Wine::Properties::COUNTRY:
-        cout << "Enter Country to Search: ";
+        propertyName = "Country";
         break;
     case Wine::Properties::TITLE:
-        cout << "Enter Wine Title to Search: ";
+        propertyName = "Wine Title";
         break;
     case Wine::Properties::PROVINCE:
-        cout << "Enter Province/State to Search: ";
+        propertyName = "Province/State";
+        break;
+    default:
+        break;
+    }
+    switch (queryType) {
+    case QueryType::EXACT:
+        cout << "Enter " << propertyName << " to Search: ";
+        getline(cin, searchKey);
+        break;
+    case QueryType::PREFIX:
+        cout << "Enter the Start of the " << propertyName << " to Search: ";
+        getline(cin, searchKey);
+        break;
+    case QueryType::RANGE:
+        cout << "Enter the First " << propertyName << " of the Range: ";
+        getline(cin, searchKey);
+        cout << "Enter the Last " << propertyName << " of the Range: ";
+        getline(cin, highKey);
         break;
     }
-    getline(cin, searchKey);
     cout << endl;
 
-    // Used to store construction and search times for each data structure. 
-    chrono::milliseconds RBTConstructTime, HTConstructTime;
-    chrono::microseconds RBTSearchTime, HTSearchTime;
-
     // Used to store search results for each data structure. 
-    vector<Wine*> RBTSearchResults, HTSearchResults;
+    vector<Wine*> RBTSearchResults, HTSearchResults, BPTSearchResults, FHTSearchResults;
 
+    // Indexes are built on first use and reused by later searches, so construction and
+    // search are timed and reported separately.
     if (useRBTree) {
-        // RBTree construction:
-        auto RBTConstructStart = chrono::high_resolution_clock::now();
-        cout << "Constructing Red Black Tree (" << wineCellar.size() << " elements):" << endl;
-        RedBlackTree rbTree(searchBy);
-        for (unsigned int i = 0; i < wineCellar.size(); i++) {
-            rbTree.insert(wineCellar[i]);
-            if ((i + 1) % (wineCellar.size() / 100) == 0)
-                loadbar((float)(i + 1) / wineCellar.size());
-        }
-        loadbar(1.0);
-        auto RBTConstructStop = chrono::high_resolution_clock::now();
-        RBTConstructTime = chrono::duration_cast<chrono::milliseconds> (RBTConstructStop - RBTConstructStart);
-        cout << endl;
+        searchIndex(IndexManager::Structure::RED_BLACK_TREE, "Red-Black Tree", searchBy, queryType, searchKey, highKey, RBTSearchResults);
+    }
+    if (useHashTable) {
+        searchIndex(IndexManager::Structure::HASH_TABLE, "Hash Table", searchBy, queryType, searchKey, highKey, HTSearchResults);
+    }
+    if (useBPlusTree) {
+        searchIndex(IndexManager::Structure::B_PLUS_TREE, "B+ Tree", searchBy, queryType, searchKey, highKey, BPTSearchResults);
+    }
+    if (useFlatHashTable) {
+        searchIndex(IndexManager::Structure::FLAT_HASH_TABLE, "Flat Hash Table", searchBy, queryType, searchKey, highKey, FHTSearchResults);
+    }
 
-        // RBTree search:
-        auto RBTSearhStart = chrono::high_resolution_clock::now();
-        cout << "Searching Red Black Tree now for \"" << searchKey << "\"... ";
-        Wine wineSearchKey;
-        wineSearchKey.setValue(searchKey, searchBy);
-        rbTree.search(&wineSearchKey, RBTSearchResults);
-        cout << "Done" << endl;
-        auto RBTSearchStop = chrono::high_resolution_clock::now();
-        RBTSearchTime = chrono::duration_cast<chrono::microseconds> (RBTSearchStop - RBTSearhStart);
-        cout << endl;
+    // Prompt to print results.
+    Wine::Properties exactBy = queryType == QueryType::EXACT ? searchBy : Wine::Properties::NONE;
+    if (!RBTSearchResults.empty()) {
+        if (yesOrNoReq("Print out results? (y/n) "))
+            printResults(RBTSearchResults, exactBy, searchKey);
+    }
+    if (!HTSearchResults.empty()) {
+        if (yesOrNoReq("Print out results? (y/n) "))
+            printResults(HTSearchResults, exactBy, searchKey);
+    }
+    if (!BPTSearchResults.empty()) {
+        if (yesOrNoReq("Print out results? (y/n) "))
+            printResults(BPTSearchResults, exactBy, searchKey);
+    }
+    if (!FHTSearchResults.empty()) {
+        if (yesOrNoReq("Print out results? (y/n) "))
+            printResults(FHTSearchResults, exactBy, searchKey);
     }
+}
 
-    if (useHashTable) {
-        // HashTable Construction:
-        auto HTConstructStart = chrono::high_resolution_clock::now();
-        HashTable hashTable(searchBy);
-        cout << "Constructing Hash Table (" << wineCellar.size() << " elements):" << endl;
-        for (unsigned int i = 0; i < wineCellar.size(); i++) {
-            hashTable.insert(wineCellar[i]);
-            if ((i + 1) % (wineCellar.size() / 100) == 0)
-                loadbar((float)(i + 1) / wineCellar.size());
+int readBound(const string& prompt, int fallback) {
+    while (true) {
+        string input;
+        cout << prompt;
+        getline(cin, input);
+        if (input.empty())
+            return fallback;
+        try {
+            // Trailing characters (such as "9O") make the whole bound invalid rather than being dropped.
+            size_t consumed;
+            int bound = stoi(input, &consumed);
+            if (consumed == input.size())
+                return bound;
         }
-        loadbar(1.0);
-        auto HTConstructStop = chrono::high_resolution_clock::now();
-        HTConstructTime = chrono::duration_cast<chrono::milliseconds> (HTConstructStop - HTConstructStart);
-        cout << endl;
+        catch (const exception&) {
+        }
+        cout << "Invalid Input. Try again." << endl;
+    }
+}
+
+void searchConjunction() {
+    cout << "Leave a value or bound empty to not filter on it." << endl;
+    vector<Predicate> predicates;
+    const pair<Wine::Properties, const char*> keyPrompts[] = {
+        { Wine::Properties::COUNTRY, "Enter Country: " },
+        { Wine::Properties::PROVINCE, "Enter Province/State: " },
+        { Wine::Properties::VARIETY, "Enter Wine Variety: " },
+        { Wine::Properties::TITLE, "Enter Wine Title: " },
+    };
+    for (const pair<Wine::Properties, const char*>& prompt : keyPrompts) {
+        string key;
+        cout << prompt.second;
+        getline(cin, key);
+        if (!key.empty())
+            predicates.push_back(Predicate::equals(prompt.first, key));
+    }
+    int minRating = readBound("Enter Minimum Rating: ", numeric_limits<int>::min());
+    int maxRating = readBound("Enter Maximum Rating: ", numeric_limits<int>::max());
+    if (minRating != numeric_limits<int>::min() || maxRating != numeric_limits<int>::max())
+        predicates.push_back(Predicate::between(Wine::Properties::RATING, minRating, maxRating));
+    int minPrice = readBound("Enter Minimum Price: ", numeric_limits<int>::min());
+    int maxPrice = readBound("Enter Maximum Price: ", numeric_limits<int>::max());
+    if (minPrice != numeric_limits<int>::min() || maxPrice != numeric_limits<int>::max())
+        predicates.push_back(Predicate::between(Wine::Properties::PRICE, minPrice, maxPrice));
+    cout << endl;
 
-        // HashTable Search:
-        auto HTSearchStart = chrono::high_resolution_clock::now();
-        cout << "Searching Hash Table now for \"" << searchKey << "\"... ";
-        hashTable.search(searchKey, HTSearchResults);
-        cout << "Done" << endl;
-        auto HTSearchStop = chrono::high_resolution_clock::now();
-        HTSearchTime = chrono::duration_cast<chrono::microseconds> (HTSearchStop - HTSearchStart);
+    QueryEngine engine(wineCellar, wineIndexes);
+    QueryEngine::Plan plan;
+    vector<WineStore::RowId> rows;
+    engine.run(predicates, rows, &plan);
+    plan.print(cout);
+    cout << "\tFound " << rows.size() << " matches!" << endl;
+    cout << endl;
+
+    if (!rows.empty()) {
+        vector<Wine*> results;
+        results.reserve(rows.size());
+        for (WineStore::RowId id : rows)
+            results.push_back(wineCellar[id]);
+        if (yesOrNoReq("Print out results? (y/n) "))
+            printResults(results);
+    }
+}
+
+QueryType getQueryType() {
+    int input = 0;
+    while (true) {
+        cout << "Which Kind of Search?" << endl;
+        cout << "1. Exact Match" << endl;
+        cout << "2. Starts With (Prefix)" << endl;
+        cout << "3. Between Two Values (Range)" << endl;
+        cin >> input;
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cout << endl;
+
+        if (cin.fail()) {
+            cout << "Invalid Input. Try again." << endl;
+            cout << endl;
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        switch (input) {
+        case 1:
+            return QueryType::EXACT;
+        case 2:
+            return QueryType::PREFIX;
+        case 3:
+            return QueryType::RANGE;
+        default:
+            cout << "Invalid Input. Try again." << endl;
+            cout << endl;
+        }
     }
+}
 
-    // Displays the construction and search times.
-    if (useRBTree) {
-        cout << "Red-Black Tree Results" << endl;
-        cout << setw(21) << "Construction time: " << RBTConstructTime.count() << " ms." << endl;
-        cout << setw(21) << "Search time: " << RBTSearchTime.count() << " microseconds" << endl;
-        cout << "\tFound " << RBTSearchResults.size() << " matches!" << endl;
+void searchIndex(IndexManager::Structure structure, const string& name, Wine::Properties searchBy, QueryType queryType,
+    const string& searchKey, const string& highKey, vector<Wine*>& results) {
+    if (queryType != QueryType::EXACT && !IndexManager::isOrdered(structure)) {
+        cout << name << " keeps no key order, so it can only answer exact matches; skipped." << endl;
         cout << endl;
+        return;
     }
-    if (useHashTable) {
-        cout << "Hash Table Results" << endl;
-        cout << setw(21) << "Construction time: " << HTConstructTime.count() << " ms." << endl;
-        cout << setw(21) << "Search time: " << HTSearchTime.count() << " microseconds." << endl;
-        cout << "\tFound " << HTSearchResults.size() << " matches!" << endl;
+
+    bool alreadyBuilt = wineIndexes.isBuilt(structure, searchBy);
+    if (!alreadyBuilt) {
+        if (wineIndexes.isBuilding(structure, searchBy))
+            cout << "Waiting for " << name << " to finish warming up (combined progress of all indexes):" << endl;
+        else
+            cout << "Constructing " << name << " (" << wineCellar.size() << " elements):" << endl;
+        wineIndexes.build(structure, searchBy, loadbar);
         cout << endl;
     }
 
-    // Prompt to print results.
-    if (!RBTSearchResults.empty()) {
-        if (yesOrNoReq("Print out results? (y/n) "))
-            printResults(RBTSearchResults);
+    // Only the lookup itself is timed; console output stays outside the measurement.
+    switch (queryType) {
+    case QueryType::EXACT:
+        cout << "Searching " << name << " now for \"" << searchKey << "\"... ";
+        break;
+    case QueryType::PREFIX:
+        cout << "Searching " << name << " now for values starting with \"" << searchKey << "\"... ";
+        break;
+    case QueryType::RANGE:
+        cout << "Searching " << name << " now for values from \"" << searchKey << "\" to \"" << highKey << "\"... ";
+        break;
     }
-    if (!HTSearchResults.empty()) {
-        if (yesOrNoReq("Print out results? (y/n) "))
-            printResults(HTSearchResults);
+    auto searchStart = chrono::high_resolution_clock::now();
+    switch (queryType) {
+    case QueryType::EXACT:
+        wineIndexes.search(structure, searchBy, searchKey, results);
+        break;
+    case QueryType::PREFIX:
+        wineIndexes.searchPrefix(structure, searchBy, searchKey, results);
+        break;
+    case QueryType::RANGE:
+        wineIndexes.searchRange(structure, searchBy, searchKey, highKey, results);
+        break;
+    }
+    auto searchStop = chrono::high_resolution_clock::now();
+    cout << "Done" << endl;
+    cout << endl;
+
+    cout << name << " Results" << endl;
+    cout << setw(21) << "Construction time: " << (int)(wineIndexes.getConstructionTime(structure, searchBy) * 1000.0) << " ms"
+        << (alreadyBuilt ? " (reused, built earlier)." : ".") << endl;
+    cout << setw(21) << "Search time: " << chrono::duration_cast<chrono::microseconds>(searchStop - searchStart).count() << " microseconds." << endl;
+    cout << "\tFound " << results.size() << " matches!" << endl;
+    cout << endl;
+
+    if (showIndexStats && structure == IndexManager::Structure::RED_BLACK_TREE) {
+        cout << name << " Stats" << endl;
+        wineIndexes.getTree(searchBy).getStats().print(cout);
+        cout << endl;
+    }
+    else if (showIndexStats && structure == IndexManager::Structure::HASH_TABLE) {
+        cout << name << " Stats" << endl;
+        wineIndexes.getHashTable(searchBy).getStats().print(cout);
+        cout << endl;
     }
 }
 
 // Iterates through results based on number selection.
-void printResults(vector<Wine*> results)
+void printResults(vector<Wine*>& results, Wine::Properties searchBy, string_view searchKey)
 {
     int numPrinted[] = { 10, 25, 50, 100 };
     int input = 0;
@@ -361,16 +572,24 @@ void printResults(vector<Wine*> results)
         }
     }
 
-    Wine::sortWine(results, sortBy);
+    // Only the printed rows need to be in order. With pre-ordered indexes they are a prefix of the key's rows;
+    // otherwise they are selected without sorting the rest.
+    vector<Wine*> topResults;
+    if (sortBy != Wine::Properties::NONE && searchBy != Wine::Properties::NONE &&
+        wineIndexes.topRows(searchBy, searchKey, sortBy, numToPrint, topResults) &&
+        wineIndexes.getPostingIndex(searchBy).count(searchKey) == results.size())
+        results.swap(topResults);
+    else
+        Wine::sortTopWine(results, sortBy, numToPrint, thread::hardware_concurrency());
 
     // Finds width of each column in table to be printed.
     int maxTitleWid = 6;
     int maxProvCountryWid = 18;
     int maxVarietyWid = 8;
     for (int i = 0; i < numToPrint; i++) {
-        int titleWid = results[i]->getTitle().size();
-        int provCountryWid = results[i]->getCountry().size() + results[i]->getProvince().size();
-        int varietyWid = results[i]->getVariety().size();
+        int titleWid = results[i]->getTitleView().size();
+        int provCountryWid = results[i]->getCountryView().size() + results[i]->getProvinceView().size();
+        int varietyWid = results[i]->getVarietyView().size();
         if (titleWid > maxTitleWid)
             maxTitleWid = titleWid;
         if (provCountryWid > maxProvCountryWid)
@@ -392,9 +611,7 @@ void printResults(vector<Wine*> results)
 }
 
 void deleteWines() {
-    for (Wine* wine : wineCellar) {
-        delete wine;
-    }
+    wineIndexes.invalidate();
     wineCellar.clear();
 }
 
@@ -442,8 +659,124 @@ bool yesOrNoReq(string outputReq)
 }
 
 
-int main() {
-    readWineCSV();
+int main(int argc, char* argv[]) {
+    // --csv FILE reads the wines from FILE instead of winemag-data-130k-v2.csv.
+    // --generate N writes N synthetic wines (e.g. 1M, 10M or 100M) to --output FILE (wines-N.csv) from --seed S (42) and exits.
+    // --threads N parses the CSV on N threads (0 uses every core).
+    // --benchmark runs the benchmarks on the wines in --csv FILE instead of the menu.
+    // --benchmark-suite runs the scaling suite at --sizes N,N,... wines (10k to 10M by default) and writes --json FILE (benchmark.json).
+    // --warmup builds every index in the background so searches don't wait for construction.
+    // --snapshot maps the wines and their array indexes from the CSV's snapshot when it is up to date. Otherwise the CSV is parsed,
+    // the posting, rating and price indexes are built and a new snapshot is written, which makes that first start slower.
+    // --batch FILE runs the queries in FILE ('-' for standard input) instead of the menu, on --workers N threads (every core by default).
+    // --index-stats prints the load factor, chain lengths and tree shape of every Red-Black Tree and Hash Table searched
+    // (and their probe, rotation and comparison counts in builds with INDEX_STATS defined).
+    // --preorder keeps every country's, province's and variety's wines ordered by price and rating, so printing the top results sorts nothing.
+    string csvPath = "winemag-data-130k-v2.csv";
+    string generateCount, generatePath;
+    uint64_t seed = 42;
+    unsigned numThreads = 1;
+    bool warmUp = false;
+    bool useSnapshot = false;
+    string batchPath;
+    bool runBenchmarks = false;
+    bool runSuite = false;
+    vector<size_t> suiteSizes = { 10000, 100000, 1000000, 10000000 };
+    string suiteJsonPath = "benchmark.json";
+    unsigned numWorkers = max(1u, thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--benchmark")
+            runBenchmarks = true;
+        if (string(argv[i]) == "--csv" && i + 1 < argc)
+            csvPath = argv[++i];
+        if (string(argv[i]) == "--generate" && i + 1 < argc)
+            generateCount = argv[++i];
+        if (string(argv[i]) == "--output" && i + 1 < argc)
+            generatePath = argv[++i];
+        if (string(argv[i]) == "--seed" && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        if (string(argv[i]) == "--benchmark-suite")
+            runSuite = true;
+        if (string(argv[i]) == "--sizes" && i + 1 < argc) {
+            suiteSizes.clear();
+            istringstream sizes(argv[++i]);
+            string size;
+            while (getline(sizes, size, ','))
+                suiteSizes.push_back((size_t)atoll(size.c_str()));
+        }
+        if (string(argv[i]) == "--json" && i + 1 < argc)
+            suiteJsonPath = argv[++i];
+        if (string(argv[i]) == "--warmup")
+            warmUp = true;
+        if (string(argv[i]) == "--snapshot")
+            useSnapshot = true;
+        if (string(argv[i]) == "--batch" && i + 1 < argc)
+            batchPath = argv[++i];
+        if (string(argv[i]) == "--workers" && i + 1 < argc)
+            numWorkers = max(1, atoi(argv[++i]));
+        if (string(argv[i]) == "--index-stats")
+            showIndexStats = true;
+        if (string(argv[i]) == "--preorder")
+            wineIndexes.setPreOrderedRows(true);
+        if (string(argv[i]) == "--threads" && i + 1 < argc) {
+            numThreads = (unsigned)atoi(argv[++i]);
+            if (numThreads == 0)
+                numThreads = max(1u, thread::hardware_concurrency());
+        }
+    }
+
+    if (!generateCount.empty()) {
+        uint64_t rows;
+        if (!DatasetGenerator::parseCount(generateCount, rows)) {
+            cout << "Invalid row count " << generateCount << endl;
+            return 1;
+        }
+        if (generatePath.empty())
+            generatePath = "wines-" + generateCount + ".csv";
+        auto start = chrono::high_resolution_clock::now();
+        if (!DatasetGenerator::writeCSV(generatePath, rows, seed, max(1u, thread::hardware_concurrency()))) {
+            cout << "Could not write " << generatePath << endl;
+            return 1;
+        }
+        auto stop = chrono::high_resolution_clock::now();
+        cout << "Wrote " << rows << " wines to " << generatePath << " (seed " << seed << ") in " << fixed << setprecision(1)
+            << chrono::duration<double>(stop - start).count() << " s." << endl;
+        return 0;
+    }
+    if (runBenchmarks) {
+        Benchmark::runAll(csvPath);
+        return 0;
+    }
+    if (runSuite) {
+        Benchmark::suite(csvPath, suiteSizes, suiteJsonPath);
+        return 0;
+    }
+    if (!batchPath.empty()) {
+        // Standard output carries only the results, so loading reports go to standard error.
+        streambuf* output = cout.rdbuf(cerr.rdbuf());
+        readWineCSV(csvPath, numThreads, useSnapshot);
+        cout.rdbuf(output);
+        size_t errors;
+        if (batchPath == "-")
+            errors = Batch::run(cin, cout, cerr, wineIndexes, numWorkers);
+        else {
+            ifstream batchFile(batchPath);
+            if (!batchFile) {
+                cerr << "Could not open " << batchPath << endl;
+                return 1;
+            }
+            errors = Batch::run(batchFile, cout, cerr, wineIndexes, numWorkers);
+        }
+        deleteWines();
+        return errors == 0 ? 0 : 1;
+    }
+
+    readWineCSV(csvPath, numThreads, useSnapshot);
+    if (warmUp) {
+        wineIndexes.warmUp(max(1u, thread::hardware_concurrency()));
+        cout << "Warming up the Red-Black Tree and Hash Table indexes in the background." << endl;
+        cout << endl;
+    }
 
     while (true) {
         preformSearch(getUserSpecifications());